@@ -0,0 +1,247 @@
+#include "lnkCorpus.h"
+#include "lnkparse.h"
+#include <cstring>
+
+
+namespace {
+
+void put16(std::string& s, uint16_t v) {
+	s += static_cast<char>(v & 0xFF);
+	s += static_cast<char>(v >> 8);
+}
+
+void put32(std::string& s, uint32_t v) {
+	put16(s, static_cast<uint16_t>(v & 0xFFFF));
+	put16(s, static_cast<uint16_t>(v >> 16));
+}
+
+void set32(std::string& s, size_t pos, uint32_t v) {
+	for(int i = 0;     i < 4;     ++i)   s[pos + i] = static_cast<char>((v >> (8 * i)) & 0xFF);
+}
+
+
+std::u16string randomText(std::mt19937& rng, size_t length, bool nonASCII) {
+	static const char16_t special[] = u"\u00E4\u00F6\u00FC\u00DF\u00E9\u20AC\u201C\u201D\u4E2D\u6587";
+	std::uniform_int_distribution<int> letter(0, 35), pick(0, 9), chance(0, 15);
+	std::u16string s;
+	s.reserve(length);
+	for(size_t i = 0;     i < length;     ++i) {
+		if(i % 9 == 8)                          s += u'\\';
+		else if(nonASCII && chance(rng) == 0)   s += special[pick(rng)];
+		else {
+			int c = letter(rng);
+			s += static_cast<char16_t>(c < 26 ? u'a' + c : u'0' + (c - 26));
+		}
+	}
+	return s;
+}
+
+
+void putZeroTerminated(std::string& s, const std::u16string& text, bool unicode) {
+	for(char16_t c : text)
+		if(unicode)   put16(s, c);
+		else          s += static_cast<char>(c < 0x100 ? c : '?');
+	if(unicode)   put16(s, 0);
+	else          s += '\0';
+}
+
+
+void putLinkTargetIDList(std::string& s, int nItemIDs, std::mt19937& rng) {
+	std::uniform_int_distribution<int> size(20, 120), byte(0, 255);
+	std::string list;
+	for(int i = 0;     i < nItemIDs;     ++i) {
+		uint16_t n = static_cast<uint16_t>(size(rng));
+		put16(list, n);
+		for(int j = 2;     j < n;     ++j)   list += static_cast<char>(byte(rng));
+	}
+	put16(list, 0); // TerminalID
+	put16(s, static_cast<uint16_t>(list.size()));
+	s += list;
+}
+
+
+void putLinkInfo(std::string& s, const LinkSpec& spec, std::mt19937& rng) {
+	const size_t begin = s.size();
+	const uint32_t headerSize = (spec.linkInfoUnicode ? 0x24 : 0x1C);
+	put32(s, 0); // LinkInfoSize, set below
+	put32(s, headerSize);
+	put32(s, spec.volumeID ? 1 : 0);
+	const size_t offsets = s.size();
+	for(uint32_t i = 12;     i < headerSize;     i += 4)   put32(s, 0);
+	auto offset = [&](int idx) { set32(s, offsets + 4 * idx, static_cast<uint32_t>(s.size() - begin)); };
+	const std::u16string base = u"C:\\" + randomText(rng, spec.stringChars, spec.nonASCII), suffix;
+	if(spec.volumeID) {
+		offset(0);
+		const size_t volumeBegin = s.size();
+		put32(s, 0); // VolumeIDSize, set below
+		put32(s, 3); // DRIVE_FIXED
+		put32(s, static_cast<uint32_t>(rng()));
+		put32(s, 0x10); // VolumeLabelOffset
+		putZeroTerminated(s, u"Data", false);
+		set32(s, volumeBegin, static_cast<uint32_t>(s.size() - volumeBegin));
+		offset(1);
+		putZeroTerminated(s, base, false);
+	}
+	offset(3);
+	putZeroTerminated(s, suffix, false);
+	if(spec.linkInfoUnicode) {
+		if(spec.volumeID) {
+			offset(4);
+			putZeroTerminated(s, base, true);
+		}
+		offset(5);
+		putZeroTerminated(s, suffix, true);
+	}
+	set32(s, begin, static_cast<uint32_t>(s.size() - begin));
+}
+
+
+void putExtraData(std::string& s, std::mt19937& rng) {
+	std::uniform_int_distribution<int> byte(0, 255);
+	auto putRandom = [&](size_t n) { for(size_t i = 0;     i < n;     ++i)   s += static_cast<char>(byte(rng)); };
+	put32(s, 0x60);
+	put32(s, static_cast<uint32_t>(ExtraDataSignature::TRACKER));
+	put32(s, 0x58);
+	put32(s, 0);
+	const std::string machine = "machine" + std::to_string(rng() % 1000);
+	s += machine;
+	s.append(16 - machine.size(), '\0');
+	putRandom(64); // Droid, DroidBirth
+	put32(s, 0x314);
+	put32(s, static_cast<uint32_t>(ExtraDataSignature::ENVIRONMENT_VARIABLE));
+	const std::u16string target = u"%ProgramFiles%\\" + randomText(rng, 30, false);
+	for(int i = 0;     i < 260;     ++i)   s += static_cast<char>(i < static_cast<int>(target.size()) ? target[i] : 0);
+	for(int i = 0;     i < 260;     ++i)   put16(s, i < static_cast<int>(target.size()) ? target[i] : 0);
+	put32(s, 0x1C);
+	put32(s, static_cast<uint32_t>(ExtraDataSignature::KNOWN_FOLDER));
+	putRandom(16);
+	put32(s, 0);
+	const uint32_t storeSize = 200 + rng() % 800;
+	put32(s, storeSize);
+	put32(s, static_cast<uint32_t>(ExtraDataSignature::PROPERTY_STORE));
+	putRandom(storeSize - 8);
+}
+
+} // namespace
+
+
+
+std::string makeLinkFile(const LinkSpec& spec, std::mt19937& rng) {
+	std::string s;
+	s.reserve(1024 + 5 * 2 * spec.stringChars + 128 * spec.nItemIDs);
+	for(uint32_t h : { 76u, 0x00021401u, 0u, 0xC0u, 0x46000000u })   put32(s, h);
+	const uint32_t flags = (spec.idList ? uint32_t{ HasLinkTargetIDList } : 0u) | (spec.linkInfo ? uint32_t{ HasLinkInfo } : 0u) |
+	                       (spec.unicode ? uint32_t{ IsUnicode } : 0u) | HasName | HasRelativePath | HasWorkingDir | HasArguments | HasIconLocation;
+	put32(s, flags);
+	put32(s, 0x20); // FileAttributes
+	for(int i = 0;     i < 6;     ++i)   put32(s, static_cast<uint32_t>(rng())); // CreationTime, AccessTime, WriteTime
+	put32(s, static_cast<uint32_t>(rng() & 0xFFFFF)); // FileSize
+	put32(s, static_cast<uint32_t>(rng() % 300)); // IconIndex
+	put32(s, 1); // ShowCommand
+	put16(s, 0); // HotKey
+	s.append(10, '\0');
+	if(spec.idList)     putLinkTargetIDList(s, spec.nItemIDs, rng);
+	if(spec.linkInfo)   putLinkInfo(s, spec, rng);
+	std::uniform_int_distribution<size_t> length(spec.stringChars / 2, spec.stringChars + spec.stringChars / 2);
+	for(int i = 0;     i < 5;     ++i) {
+		const std::u16string text = randomText(rng, length(rng), spec.nonASCII);
+		put16(s, static_cast<uint16_t>(text.size()));
+		for(char16_t c : text)
+			if(spec.unicode)   put16(s, c);
+			else               s += static_cast<char>(c < 0x100 ? c : '?');
+	}
+	if(spec.extraData)   putExtraData(s, rng);
+	put32(s, 0); // TerminalBlock of ExtraData
+	return s;
+}
+
+
+const std::vector<CorpusVariant>& corpusVariants() {
+	static const std::vector<CorpusVariant> variants = [] {
+		std::vector<CorpusVariant> v;
+		LinkSpec spec;
+		v.push_back({ "typical",        spec });
+		spec.unicode = false;
+		v.push_back({ "ansi",           spec });
+		spec = LinkSpec();
+		spec.nonASCII = true;
+		v.push_back({ "non-ascii",      spec });
+		spec = LinkSpec();
+		spec.idList = false;
+		spec.linkInfo = false;
+		v.push_back({ "strings-only",   spec });
+		spec = LinkSpec();
+		spec.linkInfoUnicode = true;
+		v.push_back({ "linkinfo-6",     spec });
+		spec = LinkSpec();
+		spec.volumeID = false;
+		v.push_back({ "no-volume-id",   spec });
+		spec = LinkSpec();
+		spec.extraData = true;
+		v.push_back({ "extradata",      spec });
+		spec = LinkSpec();
+		spec.nItemIDs = 200;
+		v.push_back({ "long-idlist",    spec });
+		spec = LinkSpec();
+		spec.stringChars = 20000;
+		v.push_back({ "big-stringdata", spec });
+		return v;
+	}();
+	return variants;
+}
+
+
+std::vector<std::string> makeCorpus(const LinkSpec& spec, size_t nFiles, uint32_t seed) {
+	std::mt19937 rng(seed);
+	std::vector<std::string> corpus;
+	corpus.reserve(nFiles);
+	for(size_t i = 0;     i < nFiles;     ++i)   corpus.push_back(makeLinkFile(spec, rng));
+	return corpus;
+}
+
+
+std::vector<std::string> makeMixedCorpus(size_t nFiles, uint32_t seed) {
+	std::mt19937 rng(seed);
+	const auto& variants = corpusVariants();
+	std::vector<std::string> corpus;
+	corpus.reserve(nFiles);
+	// the big variants are rare in practice, so the mix consists mostly of the small ones
+	std::uniform_int_distribution<size_t> pick(0, variants.size() - 1), rare(0, 99);
+	for(size_t i = 0;     i < nFiles;     ++i) {
+		size_t v = pick(rng);
+		while(variants[v].spec.nItemIDs > 50 || variants[v].spec.stringChars > 1000)
+			if(rare(rng) == 0)   break;
+			else                 v = pick(rng);
+		corpus.push_back(makeLinkFile(variants[v].spec, rng));
+	}
+	return corpus;
+}
+
+
+std::vector<std::string> makeMalformedLinkFiles(uint32_t seed) {
+	std::mt19937 rng(seed);
+	LinkSpec spec;
+	spec.idList = false; // so the LinkInfo follows the header
+	spec.linkInfoUnicode = true;
+	const std::string valid = makeLinkFile(spec, rng);
+	const size_t linkInfo = 76, volumeID = linkInfo + 0x24;
+	uint32_t linkInfoSize;
+	std::memcpy(&linkInfoSize, &valid[linkInfo], 4);
+	auto patched = [&](size_t pos, uint32_t v) { std::string s = valid;     set32(s, pos, v);     return s; };
+	std::vector<std::string> files;
+	// a header of 4093 offsets, all beyond the LinkInfo
+	std::string s = valid.substr(0, linkInfo);
+	put32(s, 0x8000);
+	put32(s, 0x4000);
+	put32(s, 1); // VolumeIDAndLocalBasePath
+	s.resize(linkInfo + 0x8000, '\xFF');
+	files.push_back(s + valid.substr(linkInfo + linkInfoSize));
+	files.push_back(patched(linkInfo,      0x7FFFFFFF));       // LinkInfoSize
+	files.push_back(patched(linkInfo + 4,  0x7FFFFFF0));       // LinkInfoHeaderSize
+	files.push_back(patched(linkInfo + 12, linkInfoSize));     // VolumeIDOffset
+	files.push_back(patched(volumeID,      0x7FFFFFF0));       // VolumeIDSize
+	files.push_back(patched(volumeID + 4,  0xFFFF));           // DriveType
+	files.push_back(patched(volumeID + 12, 0x7FFFFFF0));       // VolumeLabelOffset
+	files.push_back(patched(linkInfo + 32, linkInfoSize - 1)); // CommonPathSuffixOffsetUnicode, with room for half a character
+	return files;
+}
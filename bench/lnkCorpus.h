@@ -0,0 +1,39 @@
+#pragma once
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+
+/* Generator for synthetic link files covering the variations the parser handles.
+   The files are structurally valid according to MS-SHLLNK, their content is random. */
+struct LinkSpec {
+	bool     unicode         = true;  // IsUnicode: StringData strings in UTF-16
+	bool     idList          = true;  // HasLinkTargetIDList
+	int      nItemIDs        = 4;
+	bool     linkInfo        = true;  // HasLinkInfo
+	bool     linkInfoUnicode = false; // LinkInfo header with 6 instead of 4 offsets, paths also in UTF-16
+	bool     volumeID        = true;
+	size_t   stringChars     = 40;    // typical length of each StringData string
+	bool     nonASCII        = false; // put some non-ASCII characters into the strings
+	bool     extraData       = false; // Tracker, EnvironmentVariable, KnownFolder and PropertyStore ExtraData blocks
+};
+
+
+std::string makeLinkFile(const LinkSpec& spec, std::mt19937& rng);
+
+
+struct CorpusVariant {
+	const char* name;
+	LinkSpec    spec;
+};
+
+// The variants the benchmark covers, "mixed" draws from all of them
+const std::vector<CorpusVariant>& corpusVariants();
+
+std::vector<std::string> makeCorpus(const LinkSpec& spec, size_t nFiles, uint32_t seed);
+std::vector<std::string> makeMixedCorpus(size_t nFiles, uint32_t seed);
+
+/* Link files whose LinkInfo claims more than it has, each a valid file with one field patched; a parser must reject all of them.
+   The first has LinkInfoSize 0x8000 and LinkInfoHeaderSize 0x4000, which once overflowed the stack of the LinkInfo parser. */
+std::vector<std::string> makeMalformedLinkFiles(uint32_t seed);
@@ -0,0 +1,246 @@
+/* Throughput benchmark for the link file parser, the file loading and the output encoding.
+   Usage: lnkbench [-n filesPerCorpus] [-r repetitions] [-d corpusDirectory] [-s seed]
+   The files of the mixed corpus are written to corpusDirectory (default lnkbench_corpus) for the file loading stage
+   and are left there, so they can be used as test input for getLNKinfo as well. */
+#include "lnkCorpus.h"
+#include "lnkparse.h"
+#include "lnkparse_c.h"
+#include "lnkStream.h"
+#include "fileContent.h"
+#include "carve/linkCarver.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <new>
+#include <string>
+#include <vector>
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+
+/* Every allocation of the program goes through these, which is how allocations per parse are counted */
+namespace {
+	std::atomic<size_t> allocationCount{ 0 };
+}
+
+void* operator new(size_t n) {
+	++allocationCount;
+	if(void* p = std::malloc(n ? n : 1))   return p;
+	throw std::bad_alloc();
+}
+void* operator new[](size_t n) { return operator new(n); }
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+void operator delete[](void* p, size_t) noexcept { std::free(p); }
+
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+size_t totalBytes(const std::vector<std::string>& corpus) {
+	size_t n = 0;
+	for(const std::string& s : corpus)   n += s.size();
+	return n;
+}
+
+
+void report(const char* corpus, const char* stage, size_t nFiles, size_t nBytes, size_t nAllocs, Clock::duration t) {
+	const double seconds = std::chrono::duration<double>(t).count();
+	std::printf("%-16s %-14s %12.0f %10.1f %10.2f\n", corpus, stage, nFiles / seconds, nBytes / seconds / (1024 * 1024), double(nAllocs) / nFiles);
+}
+
+
+template<typename F>
+void run(const char* name, const char* stage, const std::vector<std::string>& corpus, int repetitions, F&& f) {
+	size_t sink = 0;
+	for(const std::string& s : corpus)   sink += f(s); // warm up
+	const size_t allocs0 = allocationCount;
+	const auto t0 = Clock::now();
+	for(int r = 0;     r < repetitions;     ++r)
+		for(const std::string& s : corpus)   sink += f(s);
+	const auto t = Clock::now() - t0;
+	const size_t nFiles = corpus.size() * repetitions;
+	report(name, stage, nFiles, totalBytes(corpus) * repetitions, allocationCount - allocs0, t);
+	if(sink == 42)   std::printf(" "); // keeps the optimizer from dropping the work
+}
+
+
+void benchCorpus(const char* name, const std::vector<std::string>& corpus, int repetitions) {
+	run(name, "LNKView", corpus, repetitions, [](const std::string& s) {
+		const LNKView v(s.data(), s.data() + s.size());
+		return static_cast<size_t>(v.afterwards - s.data());
+	});
+	run(name, "LNK", corpus, repetitions, [](const std::string& s) {
+		const LNK lnk(s.data(), s.data() + s.size());
+		return static_cast<size_t>(lnk.flags);
+	});
+	ParseContext context; // like a worker thread in a bulk run would keep it
+	run(name, "LNK+context", corpus, repetitions, [&](const std::string& s) {
+		context.reset();
+		const LNK lnk(s.data(), s.data() + s.size(), ALL_PARTS, &context);
+		return static_cast<size_t>(lnk.flags);
+	});
+	run(name, "ExtraData", corpus, repetitions, [](const std::string& s) {
+		const LNKView v(s.data(), s.data() + s.size());
+		const ExtraDataIndex extra(v.afterwards, s.data() + s.size());
+		const ExtraDataBlock* b = extra.find(ExtraDataSignature::TRACKER);
+		return (b ? TrackerDataBlock(*b).machineIDLength : size_t(0));
+	});
+	std::vector<char> buf(1 << 17); // encodes every field a getLNKinfo call can return
+	run(name, "encode-utf8", corpus, repetitions, [&](const std::string& s) {
+		lnk_file* f = nullptr;
+		if(lnk_parse(s.data(), s.size(), &f) != LNK_OK)   return size_t(0);
+		size_t n = 0, required = 0;
+		for(int field = LNK_FIELD_NAME;     field <= LNK_FIELD_KNOWN_FOLDER_ID;     ++field)
+			if(lnk_field_utf8(f, static_cast<lnk_field>(field), buf.data(), buf.size(), &required) == LNK_OK)   n += required;
+		lnk_free(f);
+		return n;
+	});
+}
+
+
+PathString corpusFileName(const std::string& dir, size_t i) {
+	const std::string s = dir + "/" + std::to_string(i) + ".lnk";
+	return PathString(s.begin(), s.end());
+}
+
+
+void benchFileLoading(const std::string& dir, const std::vector<std::string>& corpus, int repetitions) {
+#ifdef _WIN32
+	_mkdir(dir.c_str());
+#else
+	mkdir(dir.c_str(), 0777);
+#endif
+	std::vector<PathString> names;
+	for(size_t i = 0;     i < corpus.size();     ++i) {
+		std::ofstream f(dir + "/" + std::to_string(i) + ".lnk", std::ios_base::binary);
+		f.write(corpus[i].data(), corpus[i].size());
+		names.push_back(corpusFileName(dir, i));
+	}
+	FileContent content;
+	size_t sink = 0, nBytes = 0;
+	for(const PathString& n : names)   content.load(n.c_str()); // warm up the file system cache
+	const size_t allocs0 = allocationCount;
+	const auto t0 = Clock::now();
+	for(int r = 0;     r < repetitions;     ++r)
+		for(const PathString& n : names) {
+			content.load(n.c_str());
+			const LNKView v(content.begin(), content.end());
+			nBytes += content.size();
+			sink += v.flags;
+		}
+	const auto t = Clock::now() - t0;
+	report("mixed", "load+LNKView", names.size() * repetitions, nBytes, allocationCount - allocs0, t);
+	if(sink == 42)   std::printf(" ");
+}
+
+
+/* An image of random bytes with the corpus files at random sector boundaries, about one per 64 KB,
+   which is far denser than in real images, so the parsing part isn't understated */
+void benchCarving(const std::vector<std::string>& corpus, int repetitions, uint32_t seed) {
+	std::mt19937 rng(seed);
+	std::vector<char> image(64 * 1024 * 1024);
+	for(size_t i = 0;     i < image.size();     i += 4) {
+		const uint32_t r = rng();
+		std::memcpy(&image[i], &r, 4);
+	}
+	size_t nPlaced = 0;
+	for(size_t at = 0;     ;     ++nPlaced) {
+		at += (rng() % 128 + 1) * 512;
+		const std::string& f = corpus[nPlaced % corpus.size()];
+		if(at + f.size() > image.size())   break;
+		std::memcpy(&image[at], f.data(), f.size());
+		at += f.size();
+	}
+	CarveStats stats;
+	const CarveCallback count = [](const CarvedLink&) { };
+	const size_t allocs0 = allocationCount;
+	const auto t0 = Clock::now();
+	for(int r = 0;     r < repetitions;     ++r)
+		carveBuffer(image.data(), image.data() + image.size(), image.data() + image.size(), 0, 256 * 1024, count, stats);
+	const auto t = Clock::now() - t0;
+	report("image", "carve", static_cast<size_t>(stats.links), static_cast<size_t>(stats.bytes), allocationCount - allocs0, t);
+	if(stats.links != nPlaced * repetitions)
+		std::printf("carve: %llu of %zu link files found\n", static_cast<unsigned long long>(stats.links / repetitions), nPlaced);
+}
+
+
+// Decodes the LinkInfo like lnktar does with the members of an archive
+struct LinkInfoHandler : LinkStreamParser::Handler {
+	void linkInfo(const char* begin, const char* end) override { const LinkInfo info(begin, end); }
+};
+
+
+/* The malformed files must be rejected by the parser, the C API, the carver, which gets zeros after them as in an image,
+   and the stream parser, which gets them in tar blocks; a crash here, or an error of a sanitizer, is a regression too */
+void checkMalformed(uint32_t seed) {
+	const std::vector<std::string> files = makeMalformedLinkFiles(seed);
+	ParseContext context;
+	size_t nAccepted = 0;
+	for(const std::string& s : files) {
+		bool accepted = true;
+		try {   const LNK lnk(s.data(), s.data() + s.size(), ALL_PARTS, &context);   }
+		catch(const std::exception&) {   accepted = false;   }
+		lnk_file* f = nullptr;
+		if(lnk_parse(s.data(), s.size(), &f) == LNK_OK)   accepted = true;
+		lnk_free(f);
+		std::string image = s;
+		image.resize(s.size() + 64 * 1024, '\0');
+		LNKView view;
+		size_t size;
+		if(validateLink(image.data(), image.data() + image.size(), view, size, context))   accepted = true;
+		LinkInfoHandler handler;
+		LinkStreamParser stream(handler);
+		try {
+			for(size_t at = 0;     at < s.size() && !stream.done();     at += 512)     stream.feed(s.data() + at, std::min<size_t>(512, s.size() - at));
+			stream.finish();
+			accepted = true;
+		}
+		catch(const LNK_error&) { }
+		nAccepted += accepted;
+	}
+	if(nAccepted)   std::printf("malformed: %zu of %zu link files accepted\n", nAccepted, files.size());
+}
+
+} // namespace
+
+
+
+int main(int argc, char* argv[]) {
+	size_t nFiles = 2000;
+	int repetitions = 20;
+	uint32_t seed = 1;
+	std::string dir = "lnkbench_corpus";
+	for(int i = 1;     i + 1 < argc;     i += 2) {
+		if(std::strcmp(argv[i], "-n") == 0)        nFiles = std::strtoul(argv[i + 1], nullptr, 10);
+		else if(std::strcmp(argv[i], "-r") == 0)   repetitions = std::atoi(argv[i + 1]);
+		else if(std::strcmp(argv[i], "-s") == 0)   seed = static_cast<uint32_t>(std::strtoul(argv[i + 1], nullptr, 10));
+		else if(std::strcmp(argv[i], "-d") == 0)   dir = argv[i + 1];
+		else {
+			std::fprintf(stderr, "Usage: lnkbench [-n filesPerCorpus] [-r repetitions] [-d corpusDirectory] [-s seed]\n");
+			return EXIT_FAILURE;
+		}
+	}
+	if(nFiles == 0 || repetitions <= 0)   return EXIT_FAILURE;
+	checkMalformed(seed);
+	std::printf("%-16s %-14s %12s %10s %10s\n", "corpus", "stage", "files/s", "MB/s", "allocs/file");
+	for(const CorpusVariant& v : corpusVariants()) {
+		// the big variants get fewer files so every corpus takes roughly the same time
+		const size_t n = (v.spec.stringChars > 1000 || v.spec.nItemIDs > 50 ? nFiles / 20 + 1 : nFiles);
+		benchCorpus(v.name, makeCorpus(v.spec, n, seed), repetitions);
+	}
+	const std::vector<std::string> mixed = makeMixedCorpus(nFiles, seed);
+	benchCorpus("mixed", mixed, repetitions);
+	benchFileLoading(dir, mixed, repetitions / 4 + 1);
+	benchCarving(mixed, repetitions / 4 + 1, seed);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,288 @@
+#include "linkCarver.h"
+#include "cpuFeatures.h"
+#include <algorithm>
+#include <cstring>
+#include <exception>
+#include <mutex>
+#include <thread>
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+
+namespace {
+
+const char signature[linkSignatureSize] = {
+	0x4C, 0x00, 0x00, 0x00, 0x01, 0x14, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00,
+	static_cast<char>(0xC0), 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x46 };
+
+constexpr size_t mapGranularity = 64 * 1024; // allocation granularity of Windows, a multiple of the page size elsewhere
+
+
+#ifdef LNK_SSE2
+
+inline int lowestBit(uint32_t mask) {
+#ifdef _MSC_VER
+	unsigned long i;
+	_BitScanForward(&i, mask);
+	return static_cast<int>(i);
+#else
+	return __builtin_ctz(mask);
+#endif
+}
+
+
+/* The block versions compare three bytes of the signature (the first, the first of the CLSID and the last) at every
+   position of a block at once, and only positions where all three match are compared completely.
+   They stop where a whole block (with the last signature byte) no longer fits before end and return that position. */
+const char* scanSSE2(const char* p, const char* limit, const char* end, std::vector<const char*>& hits) {
+	const __m128i b0 = _mm_set1_epi8(signature[0]), b4 = _mm_set1_epi8(signature[4]), b19 = _mm_set1_epi8(signature[19]);
+	for(;     p < limit && end - p >= 16 + 19;     p += 16) {
+		const __m128i m = _mm_and_si128(_mm_and_si128(
+			_mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)), b0),
+			_mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 4)), b4)),
+			_mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 19)), b19));
+		for(uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(m));     mask;     mask &= mask - 1) {
+			const char* q = p + lowestBit(mask);
+			if(q < limit && std::memcmp(q, signature, linkSignatureSize) == 0)   hits.push_back(q);
+		}
+	}
+	return p;
+}
+
+
+LNK_TARGET_AVX2 const char* scanAVX2(const char* p, const char* limit, const char* end, std::vector<const char*>& hits) {
+	const __m256i b0 = _mm256_set1_epi8(signature[0]), b4 = _mm256_set1_epi8(signature[4]), b19 = _mm256_set1_epi8(signature[19]);
+	for(;     p < limit && end - p >= 32 + 19;     p += 32) {
+		const __m256i m = _mm256_and_si256(_mm256_and_si256(
+			_mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)), b0),
+			_mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 4)), b4)),
+			_mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 19)), b19));
+		for(uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(m));     mask;     mask &= mask - 1) {
+			const char* q = p + lowestBit(mask);
+			if(q < limit && std::memcmp(q, signature, linkSignatureSize) == 0)   hits.push_back(q);
+		}
+	}
+	return scanSSE2(p, limit, end, hits);
+}
+
+
+using ScanBlocks = const char* (*)(const char* p, const char* limit, const char* end, std::vector<const char*>& hits);
+const ScanBlocks scanBlocks = (hasAVX2() ? scanAVX2 : scanSSE2);
+
+#else
+
+const char* scanBlocks(const char* p, const char*, const char*, std::vector<const char*>&) { return p; }
+
+#endif
+
+
+/* A read-only view of part of the image file */
+class ImageFile {
+#ifdef _WIN32
+	HANDLE file = INVALID_HANDLE_VALUE;
+	HANDLE mapping = NULL;
+#else
+	int file = -1;
+#endif
+public:
+	uint64_t size = 0;
+
+	explicit ImageFile(const PathChar* path);
+	ImageFile(const ImageFile&) = delete;
+	ImageFile& operator=(const ImageFile&) = delete;
+	~ImageFile();
+	const char* map(uint64_t offset, size_t length) const; // offset must be a multiple of mapGranularity
+	static void unmap(const char* p, size_t length);
+	static void prefetch(const char* p, size_t length);    // start reading the view in, without waiting for it
+};
+
+
+#ifdef _WIN32
+
+ImageFile::ImageFile(const PathChar* path) {
+	file = CreateFile(path, GENERIC_READ, FILE_SHARE_READ|FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if(file == INVALID_HANDLE_VALUE)   throw FileError(FileError::OPEN);
+	LARGE_INTEGER fileSize;
+	if(GetFileSizeEx(file, &fileSize)) {
+		if((size = static_cast<uint64_t>(fileSize.QuadPart)) == 0)   return;
+		if((mapping = CreateFileMapping(file, NULL, PAGE_READONLY, 0, 0, NULL)))   return;
+	}
+	CloseHandle(file);
+	throw FileError(FileError::READ);
+}
+
+ImageFile::~ImageFile() {
+	if(mapping)   CloseHandle(mapping);
+	if(file != INVALID_HANDLE_VALUE)   CloseHandle(file);
+}
+
+const char* ImageFile::map(uint64_t offset, size_t length) const {
+	void* p = MapViewOfFile(mapping, FILE_MAP_READ, static_cast<DWORD>(offset >> 32), static_cast<DWORD>(offset), length);
+	if(!p)   throw FileError(FileError::READ);
+	return static_cast<const char*>(p);
+}
+
+void ImageFile::unmap(const char* p, size_t) { UnmapViewOfFile(p); }
+
+void ImageFile::prefetch(const char* p, size_t length) {
+	WIN32_MEMORY_RANGE_ENTRY range{ const_cast<char*>(p), length };
+	PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+}
+
+#else
+
+ImageFile::ImageFile(const PathChar* path) {
+	if((file = open(path, O_RDONLY|O_CLOEXEC)) < 0)   throw FileError(FileError::OPEN);
+	const off_t end = lseek(file, 0, SEEK_END); // unlike st_size, this also works for block devices
+	if(end < 0) {
+		close(file);
+		throw FileError(FileError::READ);
+	}
+	size = static_cast<uint64_t>(end);
+}
+
+ImageFile::~ImageFile() { close(file); }
+
+const char* ImageFile::map(uint64_t offset, size_t length) const {
+	void* p = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, file, static_cast<off_t>(offset));
+	if(p == MAP_FAILED)   throw FileError(FileError::READ);
+	madvise(p, length, MADV_SEQUENTIAL);
+	return static_cast<const char*>(p);
+}
+
+void ImageFile::unmap(const char* p, size_t length) { munmap(const_cast<char*>(p), length); }
+
+void ImageFile::prefetch(const char* p, size_t length) { madvise(const_cast<char*>(p), length, MADV_WILLNEED); }
+
+#endif
+
+
+/* Carves the link files starting in [from, to) of the image. The part is walked through window by window; a window is
+   mapped with maxLinkSize bytes more, so link files (and signatures) that straddle its end are complete. */
+void carvePart(const ImageFile& image, uint64_t from, uint64_t to, const CarveOptions& options, const CarveCallback& found, CarveStats& stats) {
+	struct View { const char* p = nullptr;     uint64_t offset = 0, limit = 0;     size_t length = 0; };
+	auto mapWindow = [&](uint64_t offset) {
+		View v;
+		if(offset >= to)   return v;
+		v.offset = offset;
+		v.limit  = std::min(to, offset + options.windowSize);
+		v.length = static_cast<size_t>(std::min(image.size, v.limit + options.maxLinkSize) - offset);
+		v.p      = image.map(offset, v.length);
+		return v;
+	};
+	View current = mapWindow(from);
+	while(current.p) {
+		View next = mapWindow(current.limit);
+		if(next.p)   ImageFile::prefetch(next.p, next.length); // read on while the current window is being scanned
+		carveBuffer(current.p, current.p + (current.limit - current.offset), current.p + current.length, current.offset,
+		            options.maxLinkSize, found, stats);
+		ImageFile::unmap(current.p, current.length);
+		current = next;
+	}
+}
+
+} // namespace
+
+
+
+void findLinkSignatures(const char* begin, const char* limit, const char* end, std::vector<const char*>& hits) {
+	const char* p = scanBlocks(begin, limit, end, hits);
+	for(;     p < limit && end - p >= static_cast<ptrdiff_t>(linkSignatureSize);     ++p)
+		if(*p == signature[0] && std::memcmp(p, signature, linkSignatureSize) == 0)   hits.push_back(p);
+}
+
+
+bool validateLink(const char* p, const char* limit, LNKView& view, size_t& size, ParseContext& context) {
+	auto read32 = [](const char* q) { uint32_t v;     std::memcpy(&v, q, 4);     return v; };
+	if(limit - p < 76)   return false;
+	for(int i = 66;     i < 76;     ++i) // Reserved1-3 must be zero, which weeds out most chance matches
+		if(p[i])   return false;
+	context.reset();
+	try {
+		view = LNKView(p, limit);
+		if(view.linkTargetIDList)   LinkTargetIDList(view.linkTargetIDList, limit, &context);
+		if(view.linkInfo)           LinkInfo(view.linkInfo, limit, &context);
+	}
+	catch(const std::exception&) {   return false;   }
+	// the ExtraData blocks are walked by their sizes up to the TerminalBlock
+	const char* q = view.afterwards;
+	while(limit - q >= 4) {
+		const uint32_t blockSize = read32(q);
+		if(blockSize < 4) {
+			size = static_cast<size_t>(q + 4 - p);
+			return true;
+		}
+		if(blockSize < 8 || blockSize > static_cast<size_t>(limit - q))   break;
+		q += blockSize;
+	}
+	size = static_cast<size_t>(view.afterwards - p);
+	return true;
+}
+
+
+void carveBuffer(const char* begin, const char* limit, const char* end, uint64_t baseOffset, size_t maxLinkSize,
+                 const CarveCallback& found, CarveStats& stats) {
+	constexpr size_t blockSize = 1024 * 1024; // the hits of a block are parsed while the block is still in the cache
+	std::vector<const char*> hits;
+	ParseContext context;
+	for(const char* block = begin;     block < limit;     ) {
+		const char* blockLimit = (static_cast<size_t>(limit - block) > blockSize ? block + blockSize : limit);
+		hits.clear();
+		findLinkSignatures(block, blockLimit, end, hits);
+		stats.candidates += hits.size();
+		for(const char* p : hits) {
+			LNKView view;
+			size_t size;
+			const char* parseLimit = (static_cast<size_t>(end - p) > maxLinkSize ? p + maxLinkSize : end);
+			if(!validateLink(p, parseLimit, view, size, context))   continue;
+			++stats.links;
+			found(CarvedLink{ baseOffset + static_cast<uint64_t>(p - begin), p, size, view });
+		}
+		block = blockLimit;
+	}
+	stats.bytes += static_cast<uint64_t>(limit - begin);
+}
+
+
+CarveStats carveImage(const PathChar* image, const CarveOptions& options0, const CarveCallback& found) {
+	const ImageFile file(image);
+	CarveOptions options = options0;
+	options.windowSize = std::max(mapGranularity, options.windowSize / mapGranularity * mapGranularity);
+	unsigned int nThreads = (options.nThreads ? options.nThreads : std::max(1u, std::thread::hardware_concurrency()));
+	// the parts start at multiples of the mapping granularity; small images aren't worth splitting much
+	const uint64_t minPart = 4 * options.windowSize;
+	nThreads = static_cast<unsigned int>(std::max<uint64_t>(1, std::min<uint64_t>(nThreads, (file.size + minPart - 1) / minPart)));
+	const uint64_t partSize = (file.size / nThreads + mapGranularity - 1) / mapGranularity * mapGranularity;
+	std::vector<CarveStats> stats(nThreads);
+	std::vector<std::thread> threads;
+	std::exception_ptr error;
+	std::mutex errorMutex;
+	for(unsigned int i = 0;     i < nThreads;     ++i) {
+		const uint64_t from = std::min(file.size, i * partSize);
+		const uint64_t to   = (i + 1 == nThreads ? file.size : std::min(file.size, from + partSize));
+		threads.emplace_back([&, i, from, to] {
+			try {
+				carvePart(file, from, to, options, found, stats[i]);
+			}
+			catch(...) {
+				std::lock_guard<std::mutex> lock(errorMutex);
+				if(!error)   error = std::current_exception();
+			}
+		});
+	}
+	for(std::thread& t : threads)     t.join();
+	if(error)   std::rethrow_exception(error);
+	CarveStats total;
+	for(const CarveStats& s : stats) {
+		total.bytes      += s.bytes;
+		total.candidates += s.candidates;
+		total.links      += s.links;
+	}
+	return total;
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include "fileContent.h"
+#include "lnkparse.h"
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+
+/* Recovery of link files from raw disk images, unallocated space and memory dumps.
+   Every link file starts with the same 20 bytes, HeaderSize (76) and the LinkCLSID. The image is searched for them with
+   SIMD compares, and the parser is tried on every hit with at most maxLinkSize bytes; a hit counts as a link file if the
+   header, the LinkTargetIDList, the LinkInfo and the StringData are consistent within those bytes. */
+
+constexpr size_t linkSignatureSize = 20;
+
+// Appends every p in [begin, limit) at which the signature starts to hits; the signature has to lie before end (>= limit)
+void findLinkSignatures(const char* begin, const char* limit, const char* end, std::vector<const char*>& hits);
+
+/* Checks the candidate at p, parsing no further than limit; fills view and sets size to the length of the link file
+   (up to and including the TerminalBlock, or to the end of the StringData if the ExtraData section is damaged).
+   The sections are decoded in context, which is reset first. */
+bool validateLink(const char* p, const char* limit, LNKView& view, size_t& size, ParseContext& context);
+
+
+struct CarvedLink {
+	uint64_t       offset; // in the image
+	const char*    begin;  // the link file, size bytes; valid only during the callback
+	size_t         size;
+	const LNKView& view;
+};
+using CarveCallback = std::function<void(const CarvedLink&)>;
+
+struct CarveStats {
+	uint64_t bytes      = 0;
+	uint64_t candidates = 0; // signature hits
+	uint64_t links      = 0; // of those the valid ones
+};
+
+
+struct CarveOptions {
+	unsigned int nThreads    = 0;                // 0 = one per core; each thread carves its own contiguous part of the image
+	size_t       maxLinkSize = 256 * 1024;
+	size_t       windowSize  = 32 * 1024 * 1024; // how much of the image a thread has mapped at a time, twice: the window
+	                                             // it scans and the next one, which is being read in meanwhile
+};
+
+/* Carves a link file out of every signature hit in the image; throws FileError if the image can't be read.
+   found is called from the worker threads, concurrently and in no particular order. */
+CarveStats carveImage(const PathChar* image, const CarveOptions& options, const CarveCallback& found);
+
+/* The same for a part of an image that is in memory: link files starting in [begin, limit) are carved, reading up to end.
+   baseOffset is the image offset of begin. */
+void carveBuffer(const char* begin, const char* limit, const char* end, uint64_t baseOffset, size_t maxLinkSize,
+                 const CarveCallback& found, CarveStats& stats);
@@ -0,0 +1,153 @@
+/* Carves link files out of a raw disk image or memory dump, see linkCarver.h.
+   Usage: lnkcarve [-t threads] [-m maxLinkSize] [-o directory] image
+   Writes a tab separated line per link file found, ordered by offset: offset, size, LinkFlags and the strings, as UTF-8
+   with TAB, CR, LF and backslash escaped as \t, \r, \n and \\. With -o every link file is also saved as directory/<offset>.lnk */
+#include "linkCarver.h"
+#include "utf8.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+
+namespace {
+
+void appendUTF16(std::string& s, const char16_t* p, size_t n) {
+	const size_t at = s.size();
+	s.resize(at + utf8MaxLength(n));
+	s.resize(at + utf16ToUTF8(p, n, &s[at]));
+}
+
+void appendANSI(std::string& s, const char* p, size_t n) {
+	const size_t at = s.size();
+	s.resize(at + utf8MaxLength(n));
+	s.resize(at + cp1252ToUTF8(p, n, &s[at]));
+}
+
+// Terminated strings of the LinkInfo must end before limit, the carved data around them is arbitrary
+void appendTerminated(std::string& s, const char* p, const char* limit) {
+	const char* e = p;
+	while(e < limit && *e)     ++e;
+	appendANSI(s, p, static_cast<size_t>(e - p));
+}
+
+void appendTerminated(std::string& s, const char16_t* p, const char* limit) {
+	const char16_t* e = p;
+	while(reinterpret_cast<const char*>(e + 1) <= limit && *e)     ++e;
+	appendUTF16(s, p, static_cast<size_t>(e - p));
+}
+
+
+void appendEscaped(std::string& line, const std::string& value) {
+	for(char c : value)
+		if(c != '\t' && c != '\r' && c != '\n' && c != '\\')   line += c;
+		else   (line += '\\') += (c == '\t' ? 't' : c == '\r' ? 'r' : c == '\n' ? 'n' : '\\');
+}
+
+
+std::string target(const CarvedLink& link) {
+	std::string s;
+	const char* end = link.begin + link.size;
+	if(!link.view.linkInfo) { // then the path from the shell items is all there is
+		if(!link.view.linkTargetIDList)   return s;
+		const std::u16string path = LinkTargetIDList(link.view.linkTargetIDList, end).path();
+		appendUTF16(s, path.data(), path.size());
+		return s;
+	}
+	const LinkInfo info(link.view.linkInfo, end);
+	if(const VolumeIDandBasePath* volumeID = info.volumeID.get()) {
+		if(volumeID->localBasePathUC)   appendTerminated(s, volumeID->localBasePathUC, end);
+		else                            appendTerminated(s, volumeID->localBasePath, end);
+	}
+	if(info.commonPathSuffixUC)   appendTerminated(s, info.commonPathSuffixUC, end);
+	else                          appendTerminated(s, info.commonPathSuffix, end);
+	return s;
+}
+
+
+std::string describe(const CarvedLink& link) {
+	char number[64];
+	std::snprintf(number, sizeof(number), "%llu\t%zu\t%08X", static_cast<unsigned long long>(link.offset), link.size,
+	              static_cast<unsigned int>(link.view.flags));
+	std::string line = number, value;
+	line += '\t';
+	appendEscaped(line, target(link));
+	for(StringItem item : { StringItem::NAMESTRING, StringItem::RELPATH, StringItem::WORKINGDIR, StringItem::COMMANDLINE, StringItem::ICONLOC }) {
+		const StringRef& r = link.view.string(item);
+		value.clear();
+		if(r.isUnicode)   appendUTF16(value, r.dataUC(), r.length);
+		else if(r)        appendANSI(value, r.data, r.length);
+		appendEscaped(line += '\t', value);
+	}
+	line += '\t';
+	const ExtraDataIndex extraData(link.view.afterwards, link.begin + link.size);
+	if(const ExtraDataBlock* block = extraData.find(ExtraDataSignature::TRACKER)) {
+		const TrackerDataBlock tracker(*block);
+		value.clear();
+		appendTerminated(value, tracker.machineID, tracker.machineID + tracker.machineIDLength);
+		appendEscaped(line, value);
+	}
+	return line;
+}
+
+
+int usage() {
+	std::fprintf(stderr, "Usage: lnkcarve [-t threads] [-m maxLinkSize] [-o directory] image\n");
+	return EXIT_FAILURE;
+}
+
+} // namespace
+
+
+
+int main(int argc, char* argv[]) {
+	CarveOptions options;
+	const char* image = nullptr;
+	const char* directory = nullptr;
+	for(int i = 1;     i < argc;     ++i)
+		if(std::strcmp(argv[i], "-t") == 0 && i + 1 < argc)        options.nThreads = static_cast<unsigned int>(std::strtoul(argv[++i], nullptr, 10));
+		else if(std::strcmp(argv[i], "-m") == 0 && i + 1 < argc)   options.maxLinkSize = std::strtoul(argv[++i], nullptr, 10);
+		else if(std::strcmp(argv[i], "-o") == 0 && i + 1 < argc)   directory = argv[++i];
+		else if(image || argv[i][0] == '-')                         return usage();
+		else                                                        image = argv[i];
+	if(!image || options.maxLinkSize < 76)   return usage();
+	PathString imagePath;
+	for(const char* p = image;     *p;     ++p)     imagePath += static_cast<PathChar>(static_cast<unsigned char>(*p));
+
+	std::vector<std::pair<uint64_t, std::string>> found;
+	std::mutex mutex;
+	const auto t0 = std::chrono::steady_clock::now();
+	CarveStats stats;
+	try {
+		stats = carveImage(imagePath.c_str(), options, [&](const CarvedLink& link) {
+			std::string line;
+			try {
+				line = describe(link);
+			}
+			catch(const std::exception&) {   return;   } // the LinkInfo passed validation, so this doesn't happen
+			if(directory) {
+				std::ofstream f(std::string(directory) + "/" + std::to_string(link.offset) + ".lnk", std::ios_base::binary);
+				f.write(link.begin, static_cast<std::streamsize>(link.size));
+			}
+			std::lock_guard<std::mutex> lock(mutex);
+			found.emplace_back(link.offset, std::move(line));
+		});
+	}
+	catch(const FileError& e) {
+		std::fprintf(stderr, "lnkcarve: %s\n", e.what());
+		return EXIT_FAILURE;
+	}
+	const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+	std::sort(found.begin(), found.end());
+	std::printf("offset\tsize\tflags\ttarget\tname\trelativePath\tworkingDir\targuments\ticonLocation\tmachineID\n");
+	for(const auto& f : found)     std::printf("%s\n", f.second.c_str());
+	std::fprintf(stderr, "%llu bytes in %.2f s (%.0f MB/s), %llu signatures, %llu link files\n", static_cast<unsigned long long>(stats.bytes),
+	             seconds, stats.bytes / seconds / (1024 * 1024), static_cast<unsigned long long>(stats.candidates), static_cast<unsigned long long>(stats.links));
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,260 @@
+#include "columnFile.h"
+#include <algorithm>
+#include <cstring>
+
+
+namespace {
+	constexpr char     columnMagic[8] = { 'L', 'N', 'K', 'C', 'O', 'L', 'S', '\0' };
+	constexpr uint32_t columnVersion  = 1;
+
+	struct FileHeader {
+		char     magic[8];
+		uint32_t version;
+		uint32_t reserved;
+	};
+
+	struct FooterHeader {
+		uint32_t nColumns;
+		uint32_t nRowGroups;
+		uint64_t nRows;
+	};
+
+	struct ColumnDescriptor {
+		char     name[24];
+		uint32_t type;     // ColumnType
+		uint32_t reserved;
+	};
+
+	// followed by the ChunkDescriptors of its columns
+	struct RowGroupDescriptor {
+		uint64_t nRows;
+		uint64_t reserved;
+	};
+
+	struct ChunkDescriptor {
+		uint64_t offset;
+		uint64_t size;
+		uint64_t min;
+		uint64_t max;
+	};
+
+	struct FileTrailer {
+		uint64_t footer;   // offset of the FooterHeader
+		char     magic[8];
+	};
+
+	constexpr size_t groupDescriptorSize = sizeof(RowGroupDescriptor) + columnCount * sizeof(ChunkDescriptor); // in the footer
+
+	ColumnType typeOf(Column c) { return columnInfos[static_cast<int>(c)].type; }
+}
+
+
+void ColumnRow::clear() {
+	std::fill(numbers, numbers + numericColumnCount, 0);
+	for(int i = 0;     i < stringColumnCount;     ++i) {
+		strings[i].clear();
+		present[i] = false;
+	}
+}
+
+
+
+ColumnFileWriter::ColumnFileWriter(const PathChar* columnFile, uint32_t rowGroupSize)
+	: file(columnFile, std::ios_base::binary|std::ios_base::trunc), numbers(numericColumnCount), strings(stringColumnCount), rowGroupSize(std::max(rowGroupSize, 1u)) {
+	ok = static_cast<bool>(file);
+	FileHeader h;
+	std::memset(&h, 0, sizeof(h));
+	std::memcpy(h.magic, columnMagic, sizeof(columnMagic));
+	h.version = columnVersion;
+	write(&h, sizeof(h));
+}
+
+
+void ColumnFileWriter::write(const void* p, size_t n) {
+	if(ok && !file.write(static_cast<const char*>(p), static_cast<std::streamsize>(n)))   ok = false;
+	written += n;
+}
+
+
+void ColumnFileWriter::pad() {
+	static const char zeros[8] = {};
+	write(zeros, static_cast<size_t>(-written & 7));
+}
+
+
+void ColumnFileWriter::add(const ColumnRow& row) {
+	for(int c = 0;     c < numericColumnCount;     ++c)     numbers[c].push_back(row.numbers[c]);
+	for(int c = 0;     c < stringColumnCount;     ++c) {
+		StringChunk& s = strings[c];
+		if(!row.present[c]) {
+			s.indices.push_back(uint32_t{ StringColumn::noValue });
+			continue;
+		}
+		const auto inserted = s.dictionary.emplace(row.strings[c], static_cast<uint32_t>(s.offsets.size() - 1));
+		if(inserted.second) {
+			s.blob += row.strings[c];
+			s.offsets.push_back(static_cast<uint32_t>(s.blob.size()));
+		}
+		s.indices.push_back(inserted.first->second);
+	}
+	/* offsets into the blob are uint32_t, so a row group ends early rather than have a dictionary of 4 GB;
+	   with link files that takes 64K rows of over 64 KB strings, which Windows doesn't have */
+	const bool blobFull = std::any_of(strings.begin(), strings.end(), [](const StringChunk& s) { return s.blob.size() > 0x7FFFFFFF; });
+	if(numbers[0].size() >= rowGroupSize || blobFull)   flushRowGroup();
+}
+
+
+void ColumnFileWriter::flushRowGroup() {
+	const size_t n = numbers[0].size();
+	if(n == 0)   return;
+	const RowGroupDescriptor g{ n, 0 };
+	const size_t at = chunkDescriptors.size();
+	chunkDescriptors.resize(at + groupDescriptorSize);
+	std::memcpy(&chunkDescriptors[at], &g, sizeof(g));
+	ChunkDescriptor* chunks = reinterpret_cast<ChunkDescriptor*>(&chunkDescriptors[at + sizeof(g)]);
+
+	for(int c = 0;     c < columnCount;     ++c) {
+		pad();
+		ChunkDescriptor& d = chunks[c];
+		d.offset = written;
+		d.min = d.max = 0;
+		if(c < numericColumnCount) {
+			std::vector<uint64_t>& values = numbers[c];
+			const auto minMax = std::minmax_element(values.begin(), values.end());
+			d.min = *minMax.first;
+			d.max = *minMax.second;
+			if(columnInfos[c].type == ColumnType::U64)   write(values.data(), n * sizeof(uint64_t));
+			else {
+				std::vector<uint32_t> narrow(values.begin(), values.end());
+				write(narrow.data(), n * sizeof(uint32_t));
+			}
+			values.clear();
+		}
+		else {
+			StringChunk& s = strings[c - numericColumnCount];
+			const uint32_t sizes[2]{ static_cast<uint32_t>(s.offsets.size() - 1), static_cast<uint32_t>(s.blob.size()) };
+			write(sizes, sizeof(sizes));
+			write(s.offsets.data(), s.offsets.size() * sizeof(uint32_t));
+			write(s.indices.data(), s.indices.size() * sizeof(uint32_t));
+			write(s.blob.data(), s.blob.size());
+			s = StringChunk();
+		}
+		d.size = written - d.offset;
+	}
+	++nRowGroups;
+	nRows += n;
+}
+
+
+bool ColumnFileWriter::finish() {
+	flushRowGroup();
+	pad();
+	FileTrailer t{ written, { 0 } };
+	std::memcpy(t.magic, columnMagic, sizeof(columnMagic));
+	const FooterHeader f{ static_cast<uint32_t>(columnCount), nRowGroups, nRows };
+	write(&f, sizeof(f));
+	for(const ColumnInfo& info : columnInfos) {
+		ColumnDescriptor d;
+		std::memset(&d, 0, sizeof(d));
+		std::strncpy(d.name, info.name, sizeof(d.name) - 1);
+		d.type = static_cast<uint32_t>(info.type);
+		write(&d, sizeof(d));
+	}
+	write(chunkDescriptors.data(), chunkDescriptors.size());
+	write(&t, sizeof(t));
+	if(ok && !file.flush())   ok = false;
+	file.close();
+	return ok;
+}
+
+
+
+bool ColumnFile::open(const PathChar* columnFile) {
+	content.load(columnFile);
+	nRowGroups = 0;
+	nRows      = 0;
+	const uint64_t size = content.size();
+	if(size < sizeof(FileHeader) + sizeof(FooterHeader) + sizeof(FileTrailer))   return false;
+	const FileHeader&  h = *reinterpret_cast<const FileHeader*>(content.begin());
+	const FileTrailer& t = *reinterpret_cast<const FileTrailer*>(content.end() - sizeof(FileTrailer));
+	if(std::memcmp(h.magic, columnMagic, sizeof(columnMagic)) != 0 || h.version != columnVersion || std::memcmp(t.magic, columnMagic, sizeof(columnMagic)) != 0 ||
+	   t.footer < sizeof(FileHeader) || t.footer % 8 || t.footer > size - sizeof(FileTrailer) - sizeof(FooterHeader))   return false;
+	const FooterHeader& f = *reinterpret_cast<const FooterHeader*>(content.begin() + t.footer);
+	const uint64_t footerSize = size - sizeof(FileTrailer) - t.footer - sizeof(FooterHeader);
+	if(f.nColumns != columnCount || footerSize != columnCount * sizeof(ColumnDescriptor) + uint64_t{ f.nRowGroups } * groupDescriptorSize)   return false;
+	const ColumnDescriptor* columns = reinterpret_cast<const ColumnDescriptor*>(&f + 1);
+	for(int c = 0;     c < columnCount;     ++c)
+		if(columns[c].type != static_cast<uint32_t>(columnInfos[c].type) || std::strncmp(columns[c].name, columnInfos[c].name, sizeof(columns[c].name)) != 0)   return false;
+
+	// every chunk must lie before the footer and, but for strings which are checked when they are read, be as big as its rows need
+	const char* groups = reinterpret_cast<const char*>(columns + columnCount);
+	uint64_t total = 0;
+	for(uint32_t g = 0;     g < f.nRowGroups;     ++g) {
+		const RowGroupDescriptor& group = *reinterpret_cast<const RowGroupDescriptor*>(groups + g * groupDescriptorSize);
+		const ChunkDescriptor* chunks = reinterpret_cast<const ChunkDescriptor*>(&group + 1);
+		if(group.nRows > size)   return false;
+		for(int c = 0;     c < columnCount;     ++c) {
+			const ChunkDescriptor& d = chunks[c];
+			const uint64_t need = (columnInfos[c].type == ColumnType::U64 ? group.nRows * sizeof(uint64_t) :
+			                       columnInfos[c].type == ColumnType::U32 ? group.nRows * sizeof(uint32_t) : 2 * sizeof(uint32_t));
+			if(d.offset < sizeof(FileHeader) || d.offset % 8 || d.offset > t.footer || d.size > t.footer - d.offset || d.size < need)   return false;
+		}
+		total += group.nRows;
+	}
+	if(total != f.nRows)   return false;
+	rowGroups_ = groups;
+	nRowGroups = f.nRowGroups;
+	nRows      = f.nRows;
+	return true;
+}
+
+
+uint64_t ColumnFile::rows(size_t group) const {
+	return reinterpret_cast<const RowGroupDescriptor*>(rowGroups_ + group * groupDescriptorSize)->nRows;
+}
+
+
+ColumnStats ColumnFile::stats(size_t group, Column c) const {
+	const ChunkDescriptor& d = reinterpret_cast<const ChunkDescriptor*>(rowGroups_ + group * groupDescriptorSize + sizeof(RowGroupDescriptor))[static_cast<int>(c)];
+	return ColumnStats{ d.min, d.max };
+}
+
+
+const char* ColumnFile::chunk(size_t group, Column c, uint64_t& size) const {
+	const ChunkDescriptor& d = reinterpret_cast<const ChunkDescriptor*>(rowGroups_ + group * groupDescriptorSize + sizeof(RowGroupDescriptor))[static_cast<int>(c)];
+	size = d.size;
+	return content.begin() + d.offset;
+}
+
+
+const uint32_t* ColumnFile::u32(size_t group, Column c) const {
+	uint64_t size;
+	return (typeOf(c) == ColumnType::U32 ? reinterpret_cast<const uint32_t*>(chunk(group, c, size)) : nullptr);
+}
+
+
+const uint64_t* ColumnFile::u64(size_t group, Column c) const {
+	uint64_t size;
+	return (typeOf(c) == ColumnType::U64 ? reinterpret_cast<const uint64_t*>(chunk(group, c, size)) : nullptr);
+}
+
+
+bool ColumnFile::strings(size_t group, Column c, StringColumn& s) const {
+	if(typeOf(c) != ColumnType::STRING)   return false;
+	uint64_t size;
+	const uint32_t* p = reinterpret_cast<const uint32_t*>(chunk(group, c, size));
+	const uint64_t nEntries = p[0], blobSize = p[1], n = rows(group);
+	if((nEntries + 1 + n) * sizeof(uint32_t) + blobSize > size - 2 * sizeof(uint32_t))   return false;
+	const uint32_t* offsets = p + 2;
+	const uint32_t* indices = offsets + nEntries + 1;
+	if(offsets[0] != 0 || offsets[nEntries] > blobSize)   return false;
+	for(uint64_t i = 0;     i < nEntries;     ++i)
+		if(offsets[i] > offsets[i + 1])   return false;
+	for(uint64_t i = 0;     i < n;     ++i)
+		if(indices[i] >= nEntries && indices[i] != StringColumn::noValue)   return false;
+	s.indices  = indices;
+	s.offsets  = offsets;
+	s.blob     = reinterpret_cast<const char*>(indices + n);
+	s.nEntries = static_cast<uint32_t>(nEntries);
+	return true;
+}
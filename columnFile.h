@@ -0,0 +1,126 @@
+#pragma once
+#include "fileContent.h"
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+
+/* A columnar file of the infos of many link files, for analytics that filter hundreds of thousands of them by flags, drive type,
+   volume serial and the like without parsing text again.
+   The rows are stored in row groups of up to rowGroupSize rows. Within a row group every column is one contiguous chunk:
+   the numbers as an array of uint32_t or uint64_t, the strings (UTF-8) dictionary encoded, as an index per row into a table of the
+   distinct values of the row group. For every numeric chunk the minimum and maximum are kept in the footer, so a reader can skip
+   row groups without touching them, and a query maps only the chunks of the columns it asks for.
+
+   Layout (little endian, every chunk 8 byte aligned):
+       FileHeader, the chunks of row group 0 in Column order, of row group 1, ..., the footer, FileTrailer
+       footer: FooterHeader, ColumnDescriptor per column, ChunkDescriptor per row group and column (row group major)
+       string chunk: uint32_t nEntries, uint32_t blobSize, uint32_t offsets[nEntries + 1], uint32_t indices[nRows], char blob[blobSize] */
+
+enum struct Column : uint32_t {
+	FLAGS, ICON_INDEX, DRIVE_TYPE, SERIAL_NUMBER, FILE_ATTRIBUTES, FILE_SIZE, SHOW_COMMAND, HOT_KEY, // uint32_t
+	CREATION_TIME, ACCESS_TIME, WRITE_TIME,                                                         // uint64_t FILETIMEs
+	PATH, TARGET, VOLUME_LABEL, NAME, RELATIVE_PATH, WORKING_DIR, ARGUMENTS, ICON_LOCATION,         // strings
+	MACHINE_ID, ENVIRONMENT_TARGET, KNOWN_FOLDER
+};
+enum struct ColumnType : uint32_t { U32, U64, STRING };
+
+struct ColumnInfo {
+	const char* name;
+	ColumnType  type;
+};
+
+constexpr ColumnInfo columnInfos[]{
+	{ "flags", ColumnType::U32 }, { "iconIndex", ColumnType::U32 }, { "driveType", ColumnType::U32 }, { "serialNumber", ColumnType::U32 },
+	{ "fileAttributes", ColumnType::U32 }, { "fileSize", ColumnType::U32 }, { "showCommand", ColumnType::U32 }, { "hotKey", ColumnType::U32 },
+	{ "creationTime", ColumnType::U64 }, { "accessTime", ColumnType::U64 }, { "writeTime", ColumnType::U64 },
+	{ "path", ColumnType::STRING }, { "target", ColumnType::STRING }, { "volumeLabel", ColumnType::STRING }, { "name", ColumnType::STRING },
+	{ "relativePath", ColumnType::STRING }, { "workingDir", ColumnType::STRING }, { "arguments", ColumnType::STRING },
+	{ "iconLocation", ColumnType::STRING }, { "machineID", ColumnType::STRING }, { "environmentTarget", ColumnType::STRING },
+	{ "knownFolder", ColumnType::STRING }
+};
+constexpr int columnCount        = static_cast<int>(sizeof(columnInfos) / sizeof(*columnInfos));
+constexpr int numericColumnCount = static_cast<int>(Column::PATH);
+constexpr int stringColumnCount  = columnCount - numericColumnCount;
+
+
+/* The values of a link file. driveType is 0 (DRIVE_UNKNOWN) and serialNumber 0 if the link has no VolumeID;
+   a string that isn't present is null, which is different from empty. */
+struct ColumnRow {
+	uint64_t    numbers[numericColumnCount] = {};
+	std::string strings[stringColumnCount];
+	bool        present[stringColumnCount] = {};
+
+	uint64_t&    number(Column c) { return numbers[static_cast<int>(c)]; }
+	void         set(Column c, std::string s) { strings[static_cast<int>(c) - numericColumnCount] = std::move(s);     present[static_cast<int>(c) - numericColumnCount] = true; }
+	void         clear();
+};
+
+
+class ColumnFileWriter {
+	struct StringChunk {
+		std::unordered_map<std::string, uint32_t> dictionary;
+		std::vector<uint32_t> offsets{ 0 };
+		std::vector<uint32_t> indices;
+		std::string blob;
+	};
+	std::ofstream file;
+	uint64_t      written = 0;
+	std::vector<std::vector<uint64_t>> numbers; // of the current row group, by column
+	std::vector<StringChunk> strings;
+	std::vector<char> chunkDescriptors;          // of the row groups written, as in the footer
+	uint32_t nRowGroups = 0;
+	uint64_t nRows      = 0;
+	bool     ok;
+	void write(const void* p, size_t n);
+	void pad();
+	void flushRowGroup();
+public:
+	static constexpr uint32_t defaultRowGroupSize = 64 * 1024;
+	const uint32_t rowGroupSize;
+
+	explicit ColumnFileWriter(const PathChar* columnFile, uint32_t rowGroupSize = defaultRowGroupSize);
+	void add(const ColumnRow& row);
+	bool finish(); // false if the file couldn't be written
+	uint64_t rows() const { return nRows + numbers[0].size(); } // added so far
+};
+
+
+struct ColumnStats {
+	uint64_t min = 0, max = 0; // 0 for string columns and empty row groups
+};
+
+// The strings of a column in a row group: a dictionary and an index into it per row
+struct StringColumn {
+	static constexpr uint32_t noValue = 0xFFFFFFFF; // the index of a null
+	const uint32_t* indices  = nullptr;
+	const uint32_t* offsets  = nullptr;
+	const char*     blob     = nullptr;
+	uint32_t        nEntries = 0;
+	bool            present(size_t row) const { return indices[row] != noValue; }
+	const char*     entry(uint32_t i, size_t& length) const { length = offsets[i + 1] - offsets[i];     return blob + offsets[i]; }
+	const char*     value(size_t row, size_t& length) const { return entry(indices[row], length); } // only if present
+};
+
+
+/* Reading a column file that is memory mapped: nothing is read but the footer on open, and the chunks that are asked for */
+class ColumnFile {
+	FileContent content;
+	const char* rowGroups_ = nullptr; // ChunkDescriptors
+	uint32_t    nRowGroups = 0;
+	uint64_t    nRows      = 0;
+	const char* chunk(size_t group, Column c, uint64_t& size) const;
+public:
+	// throws FileError if the file can't be read, returns false if it isn't a column file
+	bool open(const PathChar* columnFile);
+	size_t   rowGroups() const { return nRowGroups; }
+	uint64_t rows() const { return nRows; }
+	uint64_t rows(size_t group) const;
+	ColumnStats stats(size_t group, Column c) const;
+	// The chunk of a column in a row group, nullptr if it has the wrong type or is damaged
+	const uint32_t* u32(size_t group, Column c) const;
+	const uint64_t* u64(size_t group, Column c) const;
+	bool strings(size_t group, Column c, StringColumn& s) const; // false if damaged
+};
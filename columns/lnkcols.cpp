@@ -0,0 +1,244 @@
+/* Queries a column file written by getLNKinfo.exe /COLUMNS, see columnFile.h.
+   Usage: lnkcols [-w condition]... columnFile [column ...]
+   A condition is a column, an operator and a value: =, !=, <, <=, >, >= for numbers (decimal or 0x hex), & for numbers with all
+   these bits set, and = and != for strings, e.g. -w driveType=4 -w flags&0x20 -w machineID=fileserver.
+   Writes the given columns (default all) of the rows that match all conditions as tab separated lines, strings as UTF-8 with TAB,
+   CR, LF and backslash escaped as \t, \r, \n and \\ and empty if null. Only the columns in conditions and output are read, and
+   the row groups whose minimum and maximum rule out a match not even that. */
+#include "columnFile.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#ifdef _WIN32
+#include <Windows.h>
+#endif
+
+
+namespace {
+
+enum struct Op { EQ, NE, LT, LE, GT, GE, ALL_BITS };
+
+struct Condition {
+	Column      column;
+	Op          op;
+	uint64_t    number = 0;
+	std::string text;
+};
+
+
+bool findColumn(const std::string& name, Column& c) {
+	for(int i = 0;     i < columnCount;     ++i)
+		if(name == columnInfos[i].name) {
+			c = static_cast<Column>(i);
+			return true;
+		}
+	return false;
+}
+
+
+bool parseNumber(const char* s, uint64_t& value) {
+	if(!*s)   return false;
+	char* end;
+	value = std::strtoull(s, &end, 0);
+	return *end == '\0' && *s != '-';
+}
+
+
+bool parseCondition(const char* s, Condition& c) {
+	const size_t nameLength = std::strcspn(s, "=!<>&");
+	if(!findColumn(std::string(s, nameLength), c.column))   return false;
+	const char* p = s + nameLength;
+	if(p[0] == '=')                     { c.op = Op::EQ;         p += 1; }
+	else if(p[0] == '!' && p[1] == '=') { c.op = Op::NE;         p += 2; }
+	else if(p[0] == '<' && p[1] == '=') { c.op = Op::LE;         p += 2; }
+	else if(p[0] == '>' && p[1] == '=') { c.op = Op::GE;         p += 2; }
+	else if(p[0] == '<')                { c.op = Op::LT;         p += 1; }
+	else if(p[0] == '>')                { c.op = Op::GT;         p += 1; }
+	else if(p[0] == '&')                { c.op = Op::ALL_BITS;   p += 1; }
+	else   return false;
+	if(columnInfos[static_cast<int>(c.column)].type != ColumnType::STRING)   return parseNumber(p, c.number);
+	c.text = p;
+	return c.op == Op::EQ || c.op == Op::NE;
+}
+
+
+bool compare(uint64_t v, const Condition& c) {
+	switch(c.op) {
+	case Op::EQ:         return v == c.number;
+	case Op::NE:         return v != c.number;
+	case Op::LT:         return v <  c.number;
+	case Op::LE:         return v <= c.number;
+	case Op::GT:         return v >  c.number;
+	case Op::GE:         return v >= c.number;
+	case Op::ALL_BITS:   return (v & c.number) == c.number;
+	}
+	return false;
+}
+
+
+// Whether a row group with these statistics can have a row that matches; strings have none, so their row groups are read
+bool mayMatch(const ColumnStats& s, const Condition& c) {
+	if(columnInfos[static_cast<int>(c.column)].type == ColumnType::STRING)   return true;
+	switch(c.op) {
+	case Op::EQ:         return s.min <= c.number && c.number <= s.max;
+	case Op::NE:         return !(s.min == c.number && s.max == c.number);
+	case Op::LT:         return s.min <  c.number;
+	case Op::LE:         return s.min <= c.number;
+	case Op::GT:         return s.max >  c.number;
+	case Op::GE:         return s.max >= c.number;
+	case Op::ALL_BITS:   return s.max >= c.number; // a value with all these bits set is at least that big
+	}
+	return true;
+}
+
+
+void appendEscaped(std::string& line, const char* p, size_t n) {
+	for(const char* e = p + n;     p < e;     ++p)
+		if(*p != '\t' && *p != '\r' && *p != '\n' && *p != '\\')   line += *p;
+		else   (line += '\\') += (*p == '\t' ? 't' : *p == '\r' ? 'r' : *p == '\n' ? 'n' : '\\');
+}
+
+
+// A column of the current row group as it's output, whatever its type
+struct OutputColumn {
+	Column          column;
+	const uint32_t* u32 = nullptr;
+	const uint64_t* u64 = nullptr;
+	StringColumn    strings;
+	explicit OutputColumn(Column column) : column(column) { }
+};
+
+
+// On Windows the arguments are in the ANSI code page
+PathString toPath(const char* s) {
+#ifdef _WIN32
+	const int len = static_cast<int>(std::strlen(s));
+	PathString path(len, L'\0');
+	path.resize(len ? MultiByteToWideChar(CP_ACP, 0, s, len, &path[0], len) : 0);
+	return path;
+#else
+	return s;
+#endif
+}
+
+
+int usage() {
+	std::fprintf(stderr, "Usage: lnkcols [-w condition]... columnFile [column ...]\nColumns:");
+	for(const ColumnInfo& info : columnInfos)     std::fprintf(stderr, " %s", info.name);
+	std::fprintf(stderr, "\n");
+	return EXIT_FAILURE;
+}
+
+} // namespace
+
+
+
+int main(int argc, char* argv[]) {
+	std::vector<Condition> conditions;
+	int a = 1;
+	for(;     a < argc && argv[a][0] == '-';     a += 2) {
+		Condition c;
+		if(std::strcmp(argv[a], "-w") != 0 || a + 1 >= argc)   return usage();
+		if(!parseCondition(argv[a + 1], c)) {
+			std::fprintf(stderr, "lnkcols: bad condition %s\n", argv[a + 1]);
+			return usage();
+		}
+		conditions.push_back(c);
+	}
+	if(a >= argc)   return usage();
+	const char* columnFile = argv[a++];
+	std::vector<OutputColumn> columns;
+	for(;     a < argc;     ++a) {
+		Column c;
+		if(!findColumn(argv[a], c)) {
+			std::fprintf(stderr, "lnkcols: no column %s\n", argv[a]);
+			return usage();
+		}
+		columns.emplace_back(c);
+	}
+	if(columns.empty())
+		for(int i = 0;     i < columnCount;     ++i)     columns.emplace_back(static_cast<Column>(i));
+
+	ColumnFile file;
+	try {
+		if(!file.open(toPath(columnFile).c_str())) {
+			std::fprintf(stderr, "lnkcols: %s is no column file\n", columnFile);
+			return EXIT_FAILURE;
+		}
+	}
+	catch(const FileError& e) {
+		std::fprintf(stderr, "lnkcols: %s: %s\n", columnFile, e.what());
+		return EXIT_FAILURE;
+	}
+
+	std::string line;
+	for(size_t i = 0;     i < columns.size();     ++i)     (line += (i ? "\t" : "")) += columnInfos[static_cast<int>(columns[i].column)].name;
+	std::printf("%s\n", line.c_str());
+	uint64_t nMatched = 0;
+	size_t nSkipped = 0;
+	std::vector<char> match, entryMatches;
+	for(size_t g = 0;     g < file.rowGroups();     ++g) {
+		bool skip = false;
+		for(const Condition& c : conditions)     skip |= !mayMatch(file.stats(g, c.column), c);
+		if(skip) {
+			++nSkipped;
+			continue;
+		}
+		const size_t n = static_cast<size_t>(file.rows(g));
+		match.assign(n, 1);
+		for(const Condition& c : conditions) {
+			if(const uint32_t* v = file.u32(g, c.column)) {
+				for(size_t r = 0;     r < n;     ++r)     match[r] &= compare(v[r], c);
+				continue;
+			}
+			if(const uint64_t* v = file.u64(g, c.column)) {
+				for(size_t r = 0;     r < n;     ++r)     match[r] &= compare(v[r], c);
+				continue;
+			}
+			// a string is compared once per dictionary entry, not once per row
+			StringColumn s;
+			if(!file.strings(g, c.column, s)) {
+				std::fprintf(stderr, "lnkcols: %s is damaged\n", columnFile);
+				return EXIT_FAILURE;
+			}
+			entryMatches.assign(s.nEntries, 0);
+			for(uint32_t e = 0;     e < s.nEntries;     ++e) {
+				size_t length;
+				const char* p = s.entry(e, length);
+				entryMatches[e] = ((length == c.text.size() && std::memcmp(p, c.text.data(), length) == 0) == (c.op == Op::EQ));
+			}
+			for(size_t r = 0;     r < n;     ++r)     match[r] &= (s.present(r) ? entryMatches[s.indices[r]] : c.op == Op::NE);
+		}
+
+		for(OutputColumn& c : columns) {
+			c.u32 = file.u32(g, c.column);
+			c.u64 = file.u64(g, c.column);
+			if(!c.u32 && !c.u64 && !file.strings(g, c.column, c.strings)) {
+				std::fprintf(stderr, "lnkcols: %s is damaged\n", columnFile);
+				return EXIT_FAILURE;
+			}
+		}
+		for(size_t r = 0;     r < n;     ++r) {
+			if(!match[r])   continue;
+			line.clear();
+			for(size_t i = 0;     i < columns.size();     ++i) {
+				const OutputColumn& c = columns[i];
+				if(i)   line += '\t';
+				if(c.u32)        line += std::to_string(c.u32[r]);
+				else if(c.u64)   line += std::to_string(c.u64[r]);
+				else if(c.strings.present(r)) {
+					size_t length;
+					const char* p = c.strings.value(r, length);
+					appendEscaped(line, p, length);
+				}
+			}
+			std::printf("%s\n", line.c_str());
+			++nMatched;
+		}
+	}
+	std::fprintf(stderr, "%llu of %llu rows matched, %zu of %zu row groups skipped\n", static_cast<unsigned long long>(nMatched),
+	             static_cast<unsigned long long>(file.rows()), nSkipped, file.rowGroups());
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+/* x86 SIMD support. SSE2 is always there on x64; AVX2 functions are compiled with LNK_TARGET_AVX2 and only called
+   when hasAVX2() says the CPU (and OS) supports it. */
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define LNK_SSE2
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define LNK_TARGET_AVX2
+#else
+#define LNK_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+
+inline bool hasAVX2() {
+#ifdef _MSC_VER
+	int info[4];
+	__cpuid(info, 0);
+	if(info[0] < 7)   return false;
+	__cpuid(info, 1);
+	constexpr int osxsave = 1 << 27, avx = 1 << 28;
+	if((info[2] & (osxsave|avx)) != (osxsave|avx) || (_xgetbv(0) & 6) != 6)   return false; // OS saves the YMM registers
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+#else
+	__builtin_cpu_init(); // callers may be static initializers
+	return __builtin_cpu_supports("avx2");
+#endif
+}
+
+#endif
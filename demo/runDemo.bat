@@ -19,6 +19,7 @@ FOR /F "tokens=*" %%i IN ('..\bin\getLNKinfo.exe /W  exampleLinkFile.lnk') DO EC
 FOR /F "tokens=*" %%i IN ('..\bin\getLNKinfo.exe /CL exampleLinkFile.lnk') DO ECHO /CL   Command line    %%i
 FOR /F "tokens=*" %%i IN ('..\bin\getLNKinfo.exe /I  exampleLinkFile.lnk') DO ECHO /I    Icon            %%i
 FOR /F "tokens=*" %%i IN ('..\bin\getLNKinfo.exe /N  exampleLinkFile.lnk') DO ECHO /N    Link name       %%i
+FOR /F "tokens=*" %%i IN ('..\bin\getLNKinfo.exe /MID exampleLinkFile.lnk') DO ECHO /MID  Machine ID      %%i
 ECHO.
 
 :end
@@ -0,0 +1,251 @@
+#include "dirScan.h"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <dirent.h>
+#include <sys/stat.h>
+#endif
+
+
+bool isLinkFileName(const PathChar* name) {
+	size_t n = std::char_traits<PathChar>::length(name);
+	if(n < 4 || name[n - 4] != '.')   return false;
+	const char ext[] = "lnk";
+	for(int i = 0;     i < 3;     ++i)
+		if((name[n - 3 + i] | 0x20) != ext[i])   return false; // ASCII case insensitive
+	return true;
+}
+
+
+namespace {
+
+constexpr size_t maxTasksPerWorker = 4096; // beyond that a worker handles new tasks itself instead of queueing them
+constexpr size_t maxPendingResults = 4096; // workers wait for the emitting thread beyond that
+
+#ifdef _WIN32
+constexpr PathChar pathSeparator = L'\\';
+#else
+constexpr PathChar pathSeparator = '/';
+#endif
+
+
+/* Calls onEntry(name, isDirectory) for all subdirectories and link files in a directory */
+template<typename F>
+void listDirectory(const PathString& dir, F&& onEntry) {
+#ifdef _WIN32
+	WIN32_FIND_DATAW fd;
+	HANDLE hFind = FindFirstFile((dir + L"\\*").c_str(), &fd);
+	if(hFind == INVALID_HANDLE_VALUE)   return;
+	do {
+		const wchar_t* name = fd.cFileName;
+		if(fd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+			if(fd.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT)   continue; // don't follow junctions into loops
+			if(name[0] == L'.' && (name[1] == 0 || (name[1] == L'.' && name[2] == 0)))   continue;
+			onEntry(name, true);
+		} else if(isLinkFileName(name))   onEntry(name, false);
+	} while(FindNextFile(hFind, &fd));
+	FindClose(hFind);
+#else
+	DIR* d = opendir(dir.c_str());
+	if(!d)   return;
+	while(const dirent* e = readdir(d)) {
+		const char* name = e->d_name;
+		if(name[0] == '.' && (name[1] == 0 || (name[1] == '.' && name[2] == 0)))   continue;
+		unsigned char type = e->d_type;
+		if(type == DT_UNKNOWN) { // some file systems don't fill in d_type
+			struct stat st;
+			if(lstat((dir + '/' + name).c_str(), &st) != 0)   continue;
+			type = (S_ISDIR(st.st_mode) ? DT_DIR : S_ISREG(st.st_mode) ? DT_REG : DT_LNK);
+		}
+		if(type == DT_DIR)                               onEntry(name, true);
+		else if(type == DT_REG && isLinkFileName(name))  onEntry(name, false);
+	}
+	closedir(d);
+#endif
+}
+
+
+struct Task {
+	PathString path;
+	bool isDirectory;
+};
+
+
+struct Worker {
+	std::mutex        mtx;
+	std::deque<Task>  tasks; // owner takes from the back, thieves from the front
+	FileContent       content;
+};
+
+
+class Scan {
+	const ProcessLinkFile& process;
+	std::vector<std::unique_ptr<Worker>> workers;
+	std::atomic<size_t> pendingTasks{ 0 }; // queued or running; the scan is done when this drops to 0
+	std::atomic<size_t> queuedTasks{ 0 };  // in the deques
+	std::mutex              idleMtx;
+	std::condition_variable idleCV;      // signals idle workers that there's a task or that the scan is done
+	std::mutex              resultMtx;
+	std::condition_variable resultCV;    // signals the emitting thread
+	std::condition_variable resultSpace; // signals workers waiting for room in the result queue
+	std::deque<ScanResult>  results;
+	bool done = false;
+
+	void push(Worker& w, Task&& task);
+	bool pop(size_t self, Task& task);
+	void run(size_t self);
+	void execute(size_t self, Task& task);
+	void finishTask();
+public:
+	Scan(unsigned int nThreads, const ProcessLinkFile& process);
+	void start(const PathString& root, std::vector<std::thread>& threads);
+	bool nextResult(ScanResult& result); // false when the scan is finished
+};
+
+
+Scan::Scan(unsigned int nThreads, const ProcessLinkFile& process) : process(process) {
+	for(unsigned int i = 0;     i < nThreads;     ++i)
+		workers.emplace_back(std::make_unique<Worker>());
+}
+
+
+void Scan::start(const PathString& root, std::vector<std::thread>& threads) {
+	push(*workers[0], Task{ root, true });
+	for(size_t i = 0;     i < workers.size();     ++i)
+		threads.emplace_back(&Scan::run, this, i);
+}
+
+
+void Scan::push(Worker& w, Task&& task) {
+	++pendingTasks;
+	{
+		std::lock_guard<std::mutex> lock(w.mtx);
+		w.tasks.push_back(std::move(task));
+	}
+	++queuedTasks;
+	{ std::lock_guard<std::mutex> lock(idleMtx); } // a worker that found no task is waiting by now, so it gets the notification
+	idleCV.notify_one();
+}
+
+
+bool Scan::pop(size_t self, Task& task) {
+	{
+		Worker& w = *workers[self];
+		std::lock_guard<std::mutex> lock(w.mtx);
+		if(!w.tasks.empty()) {
+			task = std::move(w.tasks.back());
+			w.tasks.pop_back();
+			--queuedTasks;
+			return true;
+		}
+	}
+	for(size_t i = 1;     i < workers.size();     ++i) { // steal
+		Worker& w = *workers[(self + i) % workers.size()];
+		std::lock_guard<std::mutex> lock(w.mtx);
+		if(!w.tasks.empty()) {
+			task = std::move(w.tasks.front());
+			w.tasks.pop_front();
+			--queuedTasks;
+			return true;
+		}
+	}
+	return false;
+}
+
+
+void Scan::run(size_t self) {
+	Task task;
+	while(true) {
+		if(pop(self, task)) {
+			execute(self, task);
+			continue;
+		}
+		std::unique_lock<std::mutex> lock(idleMtx);
+		idleCV.wait(lock, [this] { return queuedTasks > 0 || pendingTasks == 0; });
+		if(pendingTasks == 0)   break;
+	}
+}
+
+
+void Scan::execute(size_t self, Task& task) {
+	Worker& w = *workers[self];
+	if(task.isDirectory) {
+		const PathString dir = std::move(task.path);
+		listDirectory(dir, [&](const PathChar* name, bool isDirectory) {
+			Task t{ dir + pathSeparator + name, isDirectory };
+			size_t nQueued;
+			{
+				std::lock_guard<std::mutex> lock(w.mtx);
+				nQueued = w.tasks.size();
+			}
+			if(nQueued < maxTasksPerWorker)   push(w, std::move(t));
+			else { // queue is full: do it right now, which bounds the queue
+				++pendingTasks;
+				execute(self, t);
+			}
+		});
+	} else {
+		ScanResult r{ std::move(task.path), std::string(), std::string() };
+		process(r, w.content);
+		std::unique_lock<std::mutex> lock(resultMtx);
+		resultSpace.wait(lock, [this] { return results.size() < maxPendingResults; });
+		results.push_back(std::move(r));
+		resultCV.notify_one();
+	}
+	finishTask();
+}
+
+
+void Scan::finishTask() {
+	if(--pendingTasks == 0) {
+		{
+			std::lock_guard<std::mutex> lock(resultMtx);
+			done = true;
+		}
+		resultCV.notify_all();
+		{ std::lock_guard<std::mutex> lock(idleMtx); }
+		idleCV.notify_all();
+	}
+}
+
+
+bool Scan::nextResult(ScanResult& result) {
+	std::unique_lock<std::mutex> lock(resultMtx);
+	resultCV.wait(lock, [this] { return !results.empty() || done; });
+	if(results.empty())   return false;
+	result = std::move(results.front());
+	results.pop_front();
+	resultSpace.notify_one();
+	return true;
+}
+
+} // namespace
+
+
+
+void scanDirectory(const PathString& root, unsigned int nThreads, ScanOrder order, const ProcessLinkFile& process, const EmitResult& emit) {
+	if(nThreads == 0)   nThreads = std::max(1u, std::thread::hardware_concurrency());
+	PathString dir = root;
+	while(dir.size() > 1 && (dir.back() == '/' || dir.back() == pathSeparator))   dir.pop_back();
+	Scan scan(nThreads, process);
+	std::vector<std::thread> threads;
+	scan.start(dir, threads);
+	ScanResult r;
+	if(order == ScanOrder::COMPLETED)
+		while(scan.nextResult(r))   emit(r);
+	else {
+		std::vector<ScanResult> all;
+		while(scan.nextResult(r))   all.push_back(std::move(r));
+		std::sort(all.begin(), all.end(), [](const ScanResult& a, const ScanResult& b) { return a.path < b.path; });
+		for(ScanResult& x : all)   emit(x);
+	}
+	for(std::thread& t : threads)   t.join();
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include "fileContent.h"
+#include <string>
+#include <functional>
+
+
+enum struct ScanOrder {
+	SORTED,   // results are emitted sorted by path once the scan is complete, so the output is deterministic
+	COMPLETED // results are emitted as soon as they are available
+};
+
+
+// What processing a link file produced, already encoded for writing to stdout and stderr
+struct ScanResult {
+	PathString  path;
+	std::string output;
+	std::string errorOutput;
+};
+
+
+bool isLinkFileName(const PathChar* name); // *.lnk, ASCII case insensitive
+
+
+/* Called on the worker threads for every *.lnk file; content is a per-thread buffer the callback may use for loading it. */
+using ProcessLinkFile = std::function<void(ScanResult& result, FileContent& content)>;
+/* Called on the thread that runs scanDirectory, one result at a time. */
+using EmitResult      = std::function<void(ScanResult& result)>;
+
+
+/* Recursively finds all *.lnk files below root and processes them on a pool of nThreads worker threads (0 = one per core).
+   Every worker has its own deque of pending directories and files: it works on the newest entry of its own deque,
+   which keeps the walk depth-first, and when that runs dry steals the oldest entry of another worker's deque, which
+   tends to be a big subtree. Deques and the queue of finished results are bounded, so memory use doesn't grow with
+   the size of the tree (except for ScanOrder::SORTED, which has to keep all results until the end).
+   Directory symlinks/junctions are not followed. */
+void scanDirectory(const PathString& root, unsigned int nThreads, ScanOrder order, const ProcessLinkFile& process, const EmitResult& emit);
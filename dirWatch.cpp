@@ -0,0 +1,189 @@
+#include "dirWatch.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <cerrno>
+#include <dirent.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#endif
+
+
+namespace {
+	constexpr size_t bufferSize = 64 * 1024; // ReadDirectoryChangesW can't give more than 64K for a network drive
+}
+
+
+bool DirWatcher::wait(std::vector<PathString>& changed, bool& overflow) {
+	changed.clear();
+	overflow = false;
+	if(!poll(-1, changed, overflow))   return false;
+	const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(maxDelayMs);
+	while(!overflow) { // until a quiet period without further changes
+		const size_t n = changed.size();
+		const auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+		if(left <= 0)   break;
+		if(!poll(static_cast<int>(std::min<long long>(left, quietMs)), changed, overflow))   return false;
+		if(changed.size() == n)   break;
+	}
+	std::sort(changed.begin(), changed.end());
+	changed.erase(std::unique(changed.begin(), changed.end()), changed.end());
+	return true;
+}
+
+
+#ifdef _WIN32
+
+namespace {
+	OVERLAPPED* asOverlapped(void* p) { return static_cast<OVERLAPPED*>(p); }
+}
+
+
+bool DirWatcher::start(const PathString& root) {
+	stop();
+	this->root = root;
+	dir = CreateFile(root.c_str(), FILE_LIST_DIRECTORY, FILE_SHARE_READ|FILE_SHARE_WRITE|FILE_SHARE_DELETE, NULL, OPEN_EXISTING,
+	                 FILE_FLAG_BACKUP_SEMANTICS|FILE_FLAG_OVERLAPPED, NULL);
+	if(dir == INVALID_HANDLE_VALUE) {
+		dir = nullptr;
+		return false;
+	}
+	event = CreateEvent(NULL, TRUE, FALSE, NULL);
+	overlapped = new OVERLAPPED;
+	buffer.resize(bufferSize / sizeof(unsigned long));
+	if(event && issue())   return true;
+	stop();
+	return false;
+}
+
+
+void DirWatcher::stop() {
+	if(dir) {
+		if(pending) {
+			CancelIo(dir);
+			DWORD n;
+			GetOverlappedResult(dir, asOverlapped(overlapped), &n, TRUE);
+		}
+		CloseHandle(dir);
+	}
+	if(event)   CloseHandle(event);
+	delete asOverlapped(overlapped);
+	dir = event = overlapped = nullptr;
+	pending = false;
+}
+
+
+bool DirWatcher::issue() {
+	std::memset(asOverlapped(overlapped), 0, sizeof(OVERLAPPED));
+	asOverlapped(overlapped)->hEvent = event;
+	pending = ReadDirectoryChangesW(dir, buffer.data(), static_cast<DWORD>(buffer.size() * sizeof(unsigned long)), TRUE,
+	                                FILE_NOTIFY_CHANGE_FILE_NAME|FILE_NOTIFY_CHANGE_DIR_NAME|FILE_NOTIFY_CHANGE_LAST_WRITE|FILE_NOTIFY_CHANGE_SIZE,
+	                                NULL, asOverlapped(overlapped), NULL) != FALSE;
+	return pending;
+}
+
+
+bool DirWatcher::poll(int timeoutMs, std::vector<PathString>& changed, bool& overflow) {
+	if(!pending)   return false;
+	const DWORD w = WaitForSingleObject(event, timeoutMs < 0 ? INFINITE : static_cast<DWORD>(timeoutMs));
+	if(w == WAIT_TIMEOUT)   return true;
+	DWORD n = 0;
+	pending = false;
+	if(w != WAIT_OBJECT_0 || !GetOverlappedResult(dir, asOverlapped(overlapped), &n, FALSE))   return false;
+	if(n == 0)   overflow = true; // more changes than fit into the buffer
+	for(const char* p = reinterpret_cast<const char*>(buffer.data());     n;) {
+		const FILE_NOTIFY_INFORMATION& info = *reinterpret_cast<const FILE_NOTIFY_INFORMATION*>(p);
+		changed.push_back((root + L'\\').append(info.FileName, info.FileNameLength / sizeof(WCHAR)));
+		if(info.NextEntryOffset == 0)   break;
+		p += info.NextEntryOffset;
+	}
+	return issue();
+}
+
+#else
+
+bool DirWatcher::start(const PathString& root) {
+	stop();
+	this->root = root;
+	if((fd = inotify_init1(IN_NONBLOCK|IN_CLOEXEC)) < 0)   return false;
+	addTree(root);
+	if(!dirs.empty())   return true;
+	stop();
+	return false;
+}
+
+
+void DirWatcher::stop() {
+	if(fd >= 0)   close(fd);
+	fd = -1;
+	dirs.clear();
+}
+
+
+void DirWatcher::addTree(const PathString& dir) {
+	const int wd = inotify_add_watch(fd, dir.c_str(), IN_CREATE|IN_DELETE|IN_MODIFY|IN_CLOSE_WRITE|IN_MOVED_FROM|IN_MOVED_TO|IN_DELETE_SELF|IN_ONLYDIR|IN_DONT_FOLLOW);
+	if(wd < 0)   return;
+	dirs[wd] = dir;
+	DIR* d = opendir(dir.c_str());
+	if(!d)   return;
+	while(const dirent* e = readdir(d)) {
+		const char* name = e->d_name;
+		if(name[0] == '.' && (name[1] == 0 || (name[1] == '.' && name[2] == 0)))   continue;
+		struct stat st;
+		const PathString path = dir + '/' + name;
+		if((e->d_type == DT_DIR || e->d_type == DT_UNKNOWN) && lstat(path.c_str(), &st) == 0 && S_ISDIR(st.st_mode))   addTree(path);
+	}
+	closedir(d);
+}
+
+
+void DirWatcher::removeTree(const PathString& dir) {
+	for(auto d = dirs.begin();     d != dirs.end();)
+		if(d->second.compare(0, dir.size(), dir) == 0 && (d->second.size() == dir.size() || d->second[dir.size()] == '/')) {
+			inotify_rm_watch(fd, d->first);
+			d = dirs.erase(d);
+		} else ++d;
+}
+
+
+bool DirWatcher::poll(int timeoutMs, std::vector<PathString>& changed, bool& overflow) {
+	if(fd < 0)   return false;
+	pollfd p{ fd, POLLIN, 0 };
+	const int r = ::poll(&p, 1, timeoutMs);
+	if(r < 0)   return errno == EINTR;
+	if(r == 0)   return true;
+	alignas(inotify_event) char buf[bufferSize];
+	for(;;) {
+		const ssize_t n = read(fd, buf, sizeof(buf));
+		if(n < 0)   return errno == EAGAIN || errno == EINTR;
+		for(const char* q = buf;     q < buf + n;) {
+			const inotify_event& e = *reinterpret_cast<const inotify_event*>(q);
+			q += sizeof(inotify_event) + e.len;
+			if(e.mask & IN_Q_OVERFLOW) {
+				overflow = true;
+				continue;
+			}
+			const auto d = dirs.find(e.wd);
+			if(d == dirs.end())   continue;
+			if(e.mask & IN_IGNORED) { // the directory is gone
+				const bool wasRoot = (d->second == root);
+				dirs.erase(d);
+				if(wasRoot)   return false;
+				continue;
+			}
+			if(!e.len)   continue;
+			const PathString path = d->second + '/' + e.name;
+			changed.push_back(path);
+			if(!(e.mask & IN_ISDIR))   continue;
+			if(e.mask & IN_MOVED_FROM)                   removeTree(path); // its watches would report the old paths
+			if(e.mask & (IN_CREATE|IN_MOVED_TO))   addTree(path);    // what's in it already was there before the watch
+		}
+	}
+}
+
+#endif
@@ -0,0 +1,42 @@
+#pragma once
+#include "fileContent.h"
+#include <unordered_map>
+#include <vector>
+
+
+/* Change notifications for a directory tree: ReadDirectoryChangesW on Windows, inotify elsewhere (with a watch per directory,
+   which is added as directories appear). Bursts are coalesced: after a change, wait() keeps collecting until nothing more
+   has happened for quietMs, or maxDelayMs have passed, and then returns every changed path once. */
+class DirWatcher {
+	PathString root;
+#ifdef _WIN32
+	void* dir   = nullptr; // HANDLE
+	void* event = nullptr;
+	void* overlapped = nullptr; // OVERLAPPED
+	std::vector<unsigned long> buffer; // DWORD aligned, as ReadDirectoryChangesW wants it
+	bool pending = false;
+	bool issue();
+#else
+	int fd = -1;
+	std::unordered_map<int, PathString> dirs; // by watch descriptor
+	void addTree(const PathString& dir);
+	void removeTree(const PathString& dir);
+#endif
+	// Collects the changes that arrive within timeoutMs (-1 = no limit); false if the watch is broken
+	bool poll(int timeoutMs, std::vector<PathString>& changed, bool& overflow);
+public:
+	unsigned int quietMs    = 200;
+	unsigned int maxDelayMs = 2000;
+
+	DirWatcher() = default;
+	DirWatcher(const DirWatcher&) = delete;
+	DirWatcher& operator=(const DirWatcher&) = delete;
+	~DirWatcher() { stop(); }
+
+	bool start(const PathString& root); // false if it can't be watched
+	void stop();
+	/* Waits for changes and returns the paths of the files and directories that were created, changed, deleted or renamed
+	   (both names), each once. If notifications were lost, overflow is set instead and everything has to be looked at again.
+	   false if the watch is broken, e.g. because root was deleted. */
+	bool wait(std::vector<PathString>& changed, bool& overflow);
+};
@@ -0,0 +1,75 @@
+#include "lnkparse.h"
+#include "unaligned.h"
+#include <cstdio>
+
+namespace {
+	const LNK_error errInLNK{ LNK_error::BROKEN };
+
+	// the block's data after checking that the block is big enough
+	const char* data(const ExtraDataBlock& block, uint32_t minSize) {
+		if(block.size < minSize)   throw errInLNK;
+		return block.data();
+	}
+
+	// length of a zero padded string in a field of fixed size
+	template<typename C>
+	size_t fieldLength(const C* s, size_t maxLength) {
+		size_t n = 0;
+		while(n < maxLength && readUnit(s + n))     ++n;
+		return n;
+	}
+}
+
+
+ExtraDataIndex::ExtraDataIndex(const char* begin, const char* end) {
+	while(begin + 4 <= end) {
+		const uint32_t size = read32(begin);
+		if(size < 4)   return; // TerminalBlock
+		if(size < 8 || size > static_cast<size_t>(end - begin))   throw errInLNK;
+		if(nBlocks < maxBlocks)   blocks[nBlocks++] = ExtraDataBlock{ static_cast<ExtraDataSignature>(read32(begin + 4)), begin, size };
+		begin += size;
+	}
+}
+
+
+const ExtraDataBlock* ExtraDataIndex::find(ExtraDataSignature signature) const {
+	for(int i = 0;     i < nBlocks;     ++i)
+		if(blocks[i].signature == signature)   return blocks + i;
+	return nullptr;
+}
+
+
+GUID_t::GUID_t(const char* p) : data1(read32(p)), data2(read16(p + 4)), data3(read16(p + 6)) {
+	for(int i = 0;     i < 8;     ++i)   data4[i] = static_cast<uint8_t>(p[8 + i]);
+}
+
+
+std::string GUID_t::toString() const {
+	char buf[40];
+	std::snprintf(buf, sizeof(buf), "{%08X-%04X-%04X-%02X%02X-%02X%02X%02X%02X%02X%02X}", static_cast<unsigned int>(data1), data2, data3,
+	              data4[0], data4[1], data4[2], data4[3], data4[4], data4[5], data4[6], data4[7]);
+	return buf;
+}
+
+
+TrackerDataBlock::TrackerDataBlock(const ExtraDataBlock& block) :
+	machineID(data(block, 0x60) + 8), machineIDLength(fieldLength(machineID, 16)),
+	volumeDroid(block.data() + 24), fileDroid(block.data() + 40), birthVolumeDroid(block.data() + 56), birthFileDroid(block.data() + 72) { }
+
+
+EnvironmentVariableDataBlock::EnvironmentVariableDataBlock(const ExtraDataBlock& block) {
+	target         = data(block, 0x314);
+	targetLength   = fieldLength(target, 260);
+	targetUC       = reinterpret_cast<const char16_t*>(block.data() + 260);
+	targetLengthUC = fieldLength(targetUC, 260);
+}
+
+
+KnownFolderDataBlock::KnownFolderDataBlock(const ExtraDataBlock& block) :
+	knownFolderID(data(block, 0x1C)), offset(read32(block.data() + 16)) { }
+
+
+SpecialFolderDataBlock::SpecialFolderDataBlock(const ExtraDataBlock& block) {
+	specialFolderID = read32(data(block, 0x10));
+	offset          = read32(block.data() + 4);
+}
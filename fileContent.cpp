@@ -0,0 +1,137 @@
+#include "fileContent.h"
+#include "stats.h"
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+namespace {
+	const FileError errOpen{ FileError::OPEN };
+	const FileError errRead{ FileError::READ };
+}
+
+
+void FileContent::extend(size_t n) {
+	if(view || n <= size())   return;
+	readUpTo(n);
+}
+
+
+#ifdef _WIN32
+
+void FileContent::load(const PathChar* pathFile, size_t prefix) {
+	release();
+	StageSpan opening(Stage::OPEN);
+	HANDLE hFile = CreateFile(pathFile, GENERIC_READ, FILE_SHARE_READ|FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if(hFile == INVALID_HANDLE_VALUE)   throw errOpen;
+	file = hFile;
+	LARGE_INTEGER size;
+	if(!GetFileSizeEx(hFile, &size))   throw errRead;
+	fileSize_ = static_cast<size_t>(size.QuadPart);
+	opening.end();
+	if(fileSize_ <= mapThreshold) {
+		buffer.clear();
+		readUpTo(prefix);
+		return;
+	}
+	StageSpan mapping(Stage::READ);
+	HANDLE hMapping = CreateFileMapping(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+	closeFile();
+	if(!hMapping)   throw errRead;
+	view = MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0);
+	CloseHandle(hMapping); // the view keeps the mapping alive
+	if(!view)   throw errRead;
+	countStat(Counter::BYTES_READ, fileSize_);
+	end_ = (begin_ = static_cast<const char*>(view)) + fileSize_;
+}
+
+
+void FileContent::readUpTo(size_t n) {
+	if(n > fileSize_)   n = fileSize_;
+	StageSpan reading(Stage::READ);
+	size_t done = buffer.size();
+	countStat(Counter::BYTES_READ, n > done ? n - done : 0); // counted up front, a failed read ends the file anyway
+	buffer.resize(n);
+	DWORD nRead = 0;
+	for(;     done < n;     done += nRead)
+		if(!ReadFile(file, buffer.data() + done, static_cast<DWORD>(n - done), &nRead, NULL) || nRead == 0)   throw errRead;
+	end_ = (begin_ = buffer.data()) + n;
+	if(n == fileSize_)   closeFile();
+}
+
+
+void FileContent::closeFile() {
+	if(file)   CloseHandle(file);
+	file = nullptr;
+}
+
+
+void FileContent::release() {
+	closeFile();
+	if(view)   UnmapViewOfFile(view);
+	view = nullptr;
+	fileSize_ = 0;
+	begin_ = end_ = nullptr;
+}
+
+#else
+
+void FileContent::load(const PathChar* pathFile, size_t prefix) {
+	release();
+	StageSpan opening(Stage::OPEN);
+	if((file = open(pathFile, O_RDONLY|O_CLOEXEC)) < 0)   throw errOpen;
+	struct stat st;
+	if(fstat(file, &st) != 0 || !S_ISREG(st.st_mode))   throw errRead;
+	fileSize_ = static_cast<size_t>(st.st_size);
+	opening.end();
+	if(fileSize_ <= mapThreshold) {
+		buffer.clear();
+		readUpTo(prefix);
+		return;
+	}
+	StageSpan mapping(Stage::READ);
+	void* p = mmap(nullptr, fileSize_, PROT_READ, MAP_PRIVATE, file, 0);
+	closeFile();
+	if(p == MAP_FAILED)   throw errRead;
+	madvise(p, fileSize_, MADV_SEQUENTIAL);
+	countStat(Counter::BYTES_READ, fileSize_);
+	view = p;
+	end_ = (begin_ = static_cast<const char*>(view)) + fileSize_;
+}
+
+
+void FileContent::readUpTo(size_t n) {
+	if(n > fileSize_)   n = fileSize_;
+	StageSpan reading(Stage::READ);
+	size_t done = buffer.size();
+	countStat(Counter::BYTES_READ, n > done ? n - done : 0); // counted up front, a failed read ends the file anyway
+	buffer.resize(n);
+	while(done < n) {
+		ssize_t nRead = read(file, buffer.data() + done, n - done);
+		if(nRead <= 0)   throw errRead;
+		done += static_cast<size_t>(nRead);
+	}
+	end_ = (begin_ = buffer.data()) + n;
+	if(n == fileSize_)   closeFile();
+}
+
+
+void FileContent::closeFile() {
+	if(file >= 0)   close(file);
+	file = -1;
+}
+
+
+void FileContent::release() {
+	closeFile();
+	if(view)   munmap(view, fileSize_);
+	view = nullptr;
+	fileSize_ = 0;
+	begin_ = end_ = nullptr;
+}
+
+#endif
@@ -0,0 +1,54 @@
+#pragma once
+#include <vector>
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+
+
+#ifdef _WIN32
+using PathChar = wchar_t;
+#else
+using PathChar = char;
+#endif
+using PathString = std::basic_string<PathChar>;
+
+
+struct FileError : std::runtime_error {
+	enum Cause { OPEN, READ } cause;
+	explicit FileError(Cause cause) : std::runtime_error(cause == OPEN ? "File doesn't exist or could not be opened" : "File could not be read"), cause(cause) { }
+};
+
+
+/* Read-only content of a file. Link files are tiny, so for them a single sized read into a buffer that is
+   reused from file to file is cheapest; larger files are mapped into memory instead of being copied.
+   Small files can also be read only partially: load a prefix, and read on with extend if it's not enough. */
+class FileContent {
+	std::vector<char> buffer;
+	const char* begin_ = nullptr;
+	const char* end_   = nullptr;
+	void*       view   = nullptr; // start of the mapped view, nullptr if content is in the buffer
+	size_t      fileSize_ = 0;
+#ifdef _WIN32
+	void*       file = nullptr;   // HANDLE, kept open while only a prefix has been read
+#else
+	int         file = -1;
+#endif
+	void readUpTo(size_t n);
+	void closeFile();
+public:
+	static constexpr size_t mapThreshold = 64 * 1024;
+
+	FileContent() = default;
+	FileContent(const FileContent&) = delete;
+	FileContent& operator=(const FileContent&) = delete;
+	~FileContent() { release(); }
+
+	// throws FileError if the file cannot be read; mapped files are always loaded completely
+	void load(const PathChar* pathFile, size_t prefix = static_cast<size_t>(-1));
+	void extend(size_t n); // reads on until the first n bytes of the file are loaded; invalidates begin() and end()
+	void release();
+	const char* begin()    const { return begin_; }
+	const char* end()      const { return end_; }
+	size_t      size()     const { return static_cast<size_t>(end_ - begin_); }
+	size_t      fileSize() const { return fileSize_; }
+};
@@ -0,0 +1,283 @@
+#include "headerFilter.h"
+#include <cstring>
+
+
+namespace {
+
+bool equalsIgnoringCase(const std::string& a, const char* b) {
+	const size_t n = std::strlen(b);
+	if(a.size() != n)   return false;
+	for(size_t i = 0;     i < n;     ++i)
+		if((a[i] | 0x20) != (b[i] | 0x20))   return false; // good enough for names of letters, digits and _
+	return true;
+}
+
+
+bool isLetter(char c) { return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_'; }
+bool isDigit(char c)  { return c >= '0' && c <= '9'; }
+
+
+// indexed by HeaderFilter::Field
+constexpr const char* fieldNames[]{ "flags", "attributes", "created", "accessed", "written", "size", "icon", "show", "hotkey" };
+constexpr int fieldCount = static_cast<int>(sizeof(fieldNames) / sizeof(*fieldNames));
+
+bool isTime(HeaderFilter::Field f) { return f == HeaderFilter::Field::CREATED || f == HeaderFilter::Field::ACCESSED || f == HeaderFilter::Field::WRITTEN; }
+
+
+uint64_t fieldValue(const LinkHeader& h, HeaderFilter::Field field) {
+	switch(field) {
+	case HeaderFilter::Field::FLAGS:        return h.flags;
+	case HeaderFilter::Field::ATTRIBUTES:   return h.fileAttributes;
+	case HeaderFilter::Field::CREATED:      return h.creationTime;
+	case HeaderFilter::Field::ACCESSED:     return h.accessTime;
+	case HeaderFilter::Field::WRITTEN:      return h.writeTime;
+	case HeaderFilter::Field::SIZE:         return h.fileSize;
+	case HeaderFilter::Field::ICON:         return h.iconIdx;
+	case HeaderFilter::Field::SHOW:         return h.showCommand;
+	case HeaderFilter::Field::HOTKEY:       return h.hotKey;
+	}
+	return 0;
+}
+
+
+bool compare(uint64_t a, HeaderFilter::Comparison c, uint64_t b) {
+	switch(c) {
+	case HeaderFilter::Comparison::EQ:   return a == b;
+	case HeaderFilter::Comparison::NE:   return a != b;
+	case HeaderFilter::Comparison::LT:   return a <  b;
+	case HeaderFilter::Comparison::LE:   return a <= b;
+	case HeaderFilter::Comparison::GT:   return a >  b;
+	case HeaderFilter::Comparison::GE:   return a >= b;
+	}
+	return false;
+}
+
+
+// Days since 1970-01-01 of a date of the proleptic Gregorian calendar
+int64_t daysFromCivil(int64_t y, unsigned int m, unsigned int d) {
+	y -= (m <= 2);
+	const int64_t era = (y >= 0 ? y : y - 399) / 400;
+	const unsigned int yoe = static_cast<unsigned int>(y - era * 400);
+	const unsigned int doy = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + d - 1;
+	const unsigned int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+	return era * 146097 + static_cast<int64_t>(doe) - 719468;
+}
+
+
+// "YYYY-MM-DD" with optionally "THH:MM" or "THH:MM:SS" as a FILETIME; false if it isn't such a date
+bool parseDate(const std::string& s, uint64_t& fileTime) {
+	unsigned int field[6]{ 0, 1, 1, 0, 0, 0 };
+	constexpr char separators[]{ '-', '-', 'T', ':', ':' };
+	size_t i = 0;
+	int n = 0;
+	for(;     n < 6;     ++n) {
+		const size_t start = i;
+		for(unsigned int value = 0;     i < s.size() && isDigit(s[i]) && i - start < 4;     ++i)     field[n] = value = value * 10 + static_cast<unsigned int>(s[i] - '0');
+		if(i - start != (n == 0 ? 4u : 2u))   return false;
+		if(i == s.size())   break;
+		if(n == 5 || (s[i] != separators[n] && !(n == 2 && s[i] == 't')))   return false;
+		++i;
+	}
+	if(n < 2 || n == 3)   return false; // the date must be complete, and a time has hours and minutes
+	static const unsigned int monthDays[]{ 31, 29, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+	if(field[0] < 1601 || field[1] < 1 || field[1] > 12 || field[2] < 1 || field[2] > monthDays[field[1] - 1] ||
+	   field[3] > 23 || field[4] > 59 || field[5] > 59)   return false;
+	if(field[1] == 2 && field[2] == 29 && (field[0] % 4 || (field[0] % 100 == 0 && field[0] % 400)))   return false;
+	constexpr int64_t daysFrom1601To1970 = 134774;
+	const int64_t days = daysFromCivil(field[0], field[1], field[2]) + daysFrom1601To1970;
+	fileTime = (static_cast<uint64_t>(days) * 86400 + field[3] * 3600 + field[4] * 60 + field[5]) * 10000000;
+	return true;
+}
+
+
+// A decimal number, or a hexadecimal one with 0x
+bool parseNumber(const std::string& s, uint64_t& value) {
+	const bool hex = s.size() > 2 && s[0] == '0' && (s[1] == 'x' || s[1] == 'X');
+	value = 0;
+	for(size_t i = (hex ? 2 : 0);     i < s.size();     ++i) {
+		const char c = s[i];
+		unsigned int digit;
+		if(isDigit(c))                             digit = static_cast<unsigned int>(c - '0');
+		else if(hex && (c | 0x20) >= 'a' && (c | 0x20) <= 'f')   digit = static_cast<unsigned int>((c | 0x20) - 'a' + 10);
+		else                                       return false;
+		if(value > (UINT64_MAX - digit) / (hex ? 16 : 10))   return false;
+		value = value * (hex ? 16 : 10) + digit;
+	}
+	return !s.empty();
+}
+
+} // namespace
+
+
+
+/* Recursive descent over the expression, emitting the program as it goes; & binds tighter than | */
+class HeaderFilter::Parser {
+	enum struct Token { END, NAME, VALUE, LPAREN, RPAREN, NOT, AND, OR, COMPARISON };
+	const std::string& s;
+	HeaderFilter& filter;
+	size_t at = 0;
+	Token  token = Token::END;
+	size_t tokenStart = 0;
+	std::string text;      // of a NAME or VALUE
+	Comparison comparison = Comparison::EQ;
+	size_t depth = 0;      // of the evaluation stack after the program so far
+	size_t nesting = 0;    // of parentheses and !
+
+	[[noreturn]] void fail(const char* message, size_t position) const { throw FilterError(message, position); }
+
+	void next() {
+		while(at < s.size() && (s[at] == ' ' || s[at] == '\t'))     ++at;
+		tokenStart = at;
+		if(at == s.size()) {
+			token = Token::END;
+			return;
+		}
+		const char c = s[at];
+		auto twoChars = [&](char second) {
+			if(at + 1 < s.size() && s[at + 1] == second) {
+				at += 2;
+				return true;
+			}
+			++at;
+			return false;
+		};
+		if(isLetter(c) || isDigit(c)) {
+			while(at < s.size() && (isLetter(s[at]) || isDigit(s[at]) || (isDigit(c) && (s[at] == '-' || s[at] == ':'))))     ++at;
+			text.assign(s, tokenStart, at - tokenStart);
+			token = (isDigit(c) ? Token::VALUE : equalsIgnoringCase(text, "and") ? Token::AND : equalsIgnoringCase(text, "or") ? Token::OR :
+			         equalsIgnoringCase(text, "not") ? Token::NOT : Token::NAME);
+			return;
+		}
+		switch(c) {
+		case '(':   ++at;   token = Token::LPAREN;   return;
+		case ')':   ++at;   token = Token::RPAREN;   return;
+		case '&':   twoChars('&');   token = Token::AND;   return;
+		case '|':   twoChars('|');   token = Token::OR;    return;
+		case '=':   twoChars('=');   token = Token::COMPARISON;   comparison = Comparison::EQ;   return;
+		case '!':
+			token = (twoChars('=') ? Token::COMPARISON : Token::NOT);
+			comparison = Comparison::NE;
+			return;
+		case '<':   token = Token::COMPARISON;   comparison = (twoChars('=') ? Comparison::LE : Comparison::LT);   return;
+		case '>':   token = Token::COMPARISON;   comparison = (twoChars('=') ? Comparison::GE : Comparison::GT);   return;
+		default:    fail("unexpected character", at);
+		}
+	}
+
+	void emit(Instruction::Op op, Field field = Field::FLAGS, Comparison comparison = Comparison::EQ, uint64_t value = 0) {
+		if(op == Instruction::ALL_BITS || op == Instruction::COMPARE) {
+			if(++depth > maxStackDepth)   fail("expression too complex", tokenStart);
+		} else if(op != Instruction::NOT)   --depth;
+		filter.program.push_back(Instruction{ op, field, comparison, value });
+	}
+
+	void nest() {
+		if(++nesting > maxStackDepth)   fail("expression too complex", tokenStart);
+	}
+
+	void parseOr() {
+		parseAnd();
+		while(token == Token::OR) {
+			next();
+			parseAnd();
+			emit(Instruction::OR);
+		}
+	}
+
+	void parseAnd() {
+		parseUnary();
+		while(token == Token::AND) {
+			next();
+			parseUnary();
+			emit(Instruction::AND);
+		}
+	}
+
+	void parseUnary() {
+		switch(token) {
+		case Token::NOT:
+			nest();
+			next();
+			parseUnary();
+			emit(Instruction::NOT);
+			--nesting;
+			return;
+		case Token::LPAREN:
+			nest();
+			next();
+			parseOr();
+			if(token != Token::RPAREN)   fail("')' expected", tokenStart);
+			next();
+			--nesting;
+			return;
+		case Token::NAME:
+			parseCondition();
+			return;
+		default:
+			fail("a name, '!' or '(' expected", tokenStart);
+		}
+	}
+
+	// a flag or attribute name, or a comparison of a field
+	void parseCondition() {
+		const std::string name = text;
+		const size_t nameStart = tokenStart;
+		next();
+		if(token != Token::COMPARISON) {
+			for(const FlagName& f : flagNames)
+				if(equalsIgnoringCase(name, f.name))   return emit(Instruction::ALL_BITS, Field::FLAGS, Comparison::EQ, f.flag);
+			for(const AttributeName& a : fileAttributeNames)
+				if(equalsIgnoringCase(name, a.name))   return emit(Instruction::ALL_BITS, Field::ATTRIBUTES, Comparison::EQ, a.attribute);
+		}
+		int f = 0;
+		while(f < fieldCount && !equalsIgnoringCase(name, fieldNames[f]))     ++f;
+		if(token != Token::COMPARISON)   fail(f < fieldCount ? "comparison expected" : "unknown flag or attribute", f < fieldCount ? tokenStart : nameStart);
+		const Comparison c = comparison;
+		if(f == fieldCount)   fail("unknown field", nameStart);
+		const Field field = static_cast<Field>(f);
+		next();
+		uint64_t value = 0;
+		if(token == Token::NAME && field == Field::SHOW) {
+			if(equalsIgnoringCase(text, "normal"))           value = SHOW_NORMAL;
+			else if(equalsIgnoringCase(text, "maximized"))   value = SHOW_MAXIMIZED;
+			else if(equalsIgnoringCase(text, "minimized"))   value = SHOW_MINNOACTIVE;
+			else fail("normal, maximized or minimized expected", tokenStart);
+		} else if(token != Token::VALUE)   fail("a value expected", tokenStart);
+		else if(!parseNumber(text, value) && !(isTime(field) && parseDate(text, value)))
+			fail(isTime(field) ? "not a date or number" : "not a number", tokenStart);
+		next();
+		emit(Instruction::COMPARE, field, c, value);
+	}
+
+public:
+	Parser(const std::string& s, HeaderFilter& filter) : s(s), filter(filter) { }
+
+	void parse() {
+		next();
+		if(token == Token::END)   return; // nothing to filter
+		parseOr();
+		if(token != Token::END)   fail("'&' or '|' expected", tokenStart);
+	}
+};
+
+
+
+HeaderFilter::HeaderFilter(const std::string& expression) {
+	Parser(expression, *this).parse();
+}
+
+
+bool HeaderFilter::matches(const LinkHeader& header) const {
+	if(program.empty())   return true;
+	bool stack[maxStackDepth];
+	size_t n = 0;
+	for(const Instruction& i : program)
+		switch(i.op) {
+		case Instruction::ALL_BITS:   stack[n++] = (fieldValue(header, i.field) & i.value) == i.value;   break;
+		case Instruction::COMPARE:    stack[n++] = compare(fieldValue(header, i.field), i.comparison, i.value);   break;
+		case Instruction::NOT:        stack[n - 1] = !stack[n - 1];   break;
+		case Instruction::AND:        --n;   stack[n - 1] = stack[n - 1] && stack[n];   break;
+		case Instruction::OR:         --n;   stack[n - 1] = stack[n - 1] || stack[n];   break;
+		}
+	return stack[0];
+}
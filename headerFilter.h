@@ -0,0 +1,49 @@
+#pragma once
+#include "lnkparse.h"
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+
+/* A condition on the LinkHeader of link files, to pick out the interesting ones before anything else of them is parsed:
+   the header is the first LinkHeader::size bytes, so a file that doesn't match costs a read of those and nothing more.
+
+   The expression is made of
+       names of flags and file attributes   HasArguments, RunAsUser, Hidden, Directory, ... (see flagNames, fileAttributeNames)
+       comparisons                          field op value, with op one of = != < <= > >=
+       !  &  |  and parentheses             (also not, and, or; && and || are the same as & and |)
+   The fields are flags, attributes, created, accessed, written, size, icon, show and hotkey. Values are numbers (0x for hex),
+   dates for the times (2024-01-31 or 2024-01-31T12:00[:00], UTC; a time that isn't set is 0, i.e. before any date), and
+   normal, maximized or minimized for show. Names and keywords are case insensitive. Example:
+       HasArguments & RunAsUser | written >= 2024-01-01 & !Directory
+   Matching a header allocates nothing. */
+
+struct FilterError : std::runtime_error {
+	size_t position; // in the expression
+	FilterError(const std::string& message, size_t position) : std::runtime_error(message), position(position) { }
+};
+
+
+class HeaderFilter {
+public:
+	enum struct Field : uint8_t { FLAGS, ATTRIBUTES, CREATED, ACCESSED, WRITTEN, SIZE, ICON, SHOW, HOTKEY };
+	enum struct Comparison : uint8_t { EQ, NE, LT, LE, GT, GE };
+private:
+	// the expression in postfix order
+	struct Instruction {
+		enum Op : uint8_t { ALL_BITS, COMPARE, NOT, AND, OR } op;
+		Field      field;
+		Comparison comparison;
+		uint64_t   value; // the bits of ALL_BITS, the operand of COMPARE
+	};
+	std::vector<Instruction> program;
+	class Parser;
+public:
+	static constexpr size_t maxStackDepth = 64; // and as deep as parentheses and ! may be nested
+
+	HeaderFilter() = default; // matches everything
+	explicit HeaderFilter(const std::string& expression); // throws FilterError if it isn't a valid expression
+	bool matches(const LinkHeader& header) const;
+	bool empty() const { return program.empty(); }
+};
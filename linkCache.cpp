@@ -0,0 +1,390 @@
+#include "linkCache.h"
+#include <algorithm>
+#include <cstring>
+#include <vector>
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <climits>
+#include <cstdlib>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+
+namespace {
+	constexpr char     cacheMagic[8]        = { 'L', 'N', 'K', 'C', 'A', 'C', 'H', 'E' };
+	constexpr uint32_t cacheVersion         = 1;
+	constexpr uint32_t initialIndexCapacity = 1024; // always a power of 2
+	constexpr uint16_t missingField         = 0xFFFF;
+
+	struct Header {
+		char     magic[8];
+		uint32_t version;
+		uint32_t pathCharSize;  // cache files of Windows and of other systems are not interchangeable
+		uint32_t indexCapacity;
+		uint32_t nEntries;
+		uint64_t dataEnd;       // end of the last record
+		uint64_t reserved[4];
+	};
+
+	struct Slot {
+		uint64_t hash;
+		uint64_t offset;        // of the record, 0 = empty slot
+	};
+
+	// followed by the path (pathLength PathChars) and the fields (char16_t), padded to a multiple of 8 bytes
+	struct Record {
+		uint32_t size;
+		uint32_t pathLength;
+		uint64_t fileSize;
+		uint64_t mtime;
+		uint32_t flags;
+		uint32_t iconIdx;
+		uint16_t fieldLength[cachedFieldCount]; // missingField if not present
+		const PathChar* path() const { return reinterpret_cast<const PathChar*>(this + 1); }
+		const char16_t* fields() const { return reinterpret_cast<const char16_t*>(path() + pathLength); }
+	};
+
+	uint64_t indexEnd(uint32_t capacity) { return sizeof(Header) + uint64_t{ capacity } * sizeof(Slot); }
+	uint64_t align8(uint64_t n) { return (n + 7) & ~uint64_t{ 7 }; }
+	bool tooFull(uint32_t nEntries, uint32_t capacity) { return uint64_t{ nEntries } * 10 > uint64_t{ capacity } * 7; }
+
+	uint64_t hashPath(const PathChar* path, size_t n) { // FNV-1a
+		const unsigned char* p = reinterpret_cast<const unsigned char*>(path);
+		uint64_t h = 14695981039346656037ull;
+		for(size_t i = 0;     i < n * sizeof(PathChar);     ++i)     h = (h ^ p[i]) * 1099511628211ull;
+		return h;
+	}
+
+	void initHeader(Header& h, uint32_t indexCapacity) {
+		std::memset(&h, 0, sizeof(h));
+		std::memcpy(h.magic, cacheMagic, sizeof(cacheMagic));
+		h.version       = cacheVersion;
+		h.pathCharSize  = sizeof(PathChar);
+		h.indexCapacity = indexCapacity;
+		h.dataEnd       = indexEnd(indexCapacity);
+	}
+
+	/* The record at the offset of a slot, nullptr if it doesn't lie within the data or its lengths don't fit its size:
+	   open() only checks the header, a damaged record must just be a cache miss */
+	const Record* recordAt(const char* view, uint64_t mappedSize, uint64_t offset) {
+		const Header& h = *reinterpret_cast<const Header*>(view);
+		const uint64_t dataEnd = std::min(h.dataEnd, mappedSize);
+		if(offset < indexEnd(h.indexCapacity) || offset % 8 || offset > dataEnd || dataEnd - offset < sizeof(Record))   return nullptr;
+		const Record& r = *reinterpret_cast<const Record*>(view + offset);
+		if(r.size < sizeof(Record) || r.size > dataEnd - offset || r.pathLength > (r.size - sizeof(Record)) / sizeof(PathChar))   return nullptr;
+		uint64_t rest = r.size - sizeof(Record) - uint64_t{ r.pathLength } * sizeof(PathChar);
+		for(int i = 0;     i < cachedFieldCount;     ++i) {
+			if(r.fieldLength[i] == missingField)   continue;
+			if(r.fieldLength[i] > rest / sizeof(char16_t))   return nullptr;
+			rest -= r.fieldLength[i] * sizeof(char16_t);
+		}
+		return &r;
+	}
+}
+
+
+#ifdef _WIN32
+
+bool getFileStamp(const PathChar* pathFile, FileStamp& stamp) {
+	WIN32_FILE_ATTRIBUTE_DATA data;
+	if(!GetFileAttributesEx(pathFile, GetFileExInfoStandard, &data) || (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))   return false;
+	stamp.size  = (uint64_t{ data.nFileSizeHigh } << 32) | data.nFileSizeLow;
+	stamp.mtime = (uint64_t{ data.ftLastWriteTime.dwHighDateTime } << 32) | data.ftLastWriteTime.dwLowDateTime;
+	return true;
+}
+
+
+PathString absolutePath(const PathChar* pathFile) {
+	const DWORD n = GetFullPathName(pathFile, 0, NULL, NULL);
+	if(n == 0)   return pathFile;
+	PathString s(n, L'\0');
+	s.resize(GetFullPathName(pathFile, n, &s[0], NULL));
+	return s;
+}
+
+
+bool LinkCache::map(uint64_t size) { // a mapping bigger than the file enlarges the file
+	HANDLE hMapping = CreateFileMapping(file, NULL, PAGE_READWRITE, static_cast<DWORD>(size >> 32), static_cast<DWORD>(size), NULL);
+	if(!hMapping)   return false;
+	view = static_cast<char*>(MapViewOfFile(hMapping, FILE_MAP_WRITE, 0, 0, static_cast<SIZE_T>(size)));
+	CloseHandle(hMapping); // the view keeps the mapping alive
+	mappedSize = (view ? size : 0);
+	return view != nullptr;
+}
+
+
+void LinkCache::unmap() {
+	if(view)   UnmapViewOfFile(view);
+	view = nullptr;
+	mappedSize = 0;
+}
+
+
+namespace {
+	bool truncateFile(void* file, uint64_t size) {
+		LARGE_INTEGER pos;
+		pos.QuadPart = static_cast<LONGLONG>(size);
+		return SetFilePointerEx(file, pos, NULL, FILE_BEGIN) && SetEndOfFile(file);
+	}
+}
+
+
+bool LinkCache::openLocked(const PathChar* cacheFile, uint64_t& fileSize) {
+	HANDLE hFile = CreateFile(cacheFile, GENERIC_READ|GENERIC_WRITE, FILE_SHARE_READ|FILE_SHARE_WRITE, NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	if(hFile == INVALID_HANDLE_VALUE)   return false;
+	file = hFile;
+	OVERLAPPED ov{};
+	LARGE_INTEGER size;
+	// another process using the cache makes us go without it rather than wait for it to finish
+	if(!LockFileEx(hFile, LOCKFILE_EXCLUSIVE_LOCK|LOCKFILE_FAIL_IMMEDIATELY, 0, MAXDWORD, MAXDWORD, &ov) || !GetFileSizeEx(hFile, &size))   return false;
+	fileSize = static_cast<uint64_t>(size.QuadPart);
+	return true;
+}
+
+#else
+
+bool getFileStamp(const PathChar* pathFile, FileStamp& stamp) {
+	struct stat st;
+	if(stat(pathFile, &st) != 0 || !S_ISREG(st.st_mode))   return false;
+	stamp.size  = static_cast<uint64_t>(st.st_size);
+#ifdef __APPLE__
+	stamp.mtime = static_cast<uint64_t>(st.st_mtimespec.tv_sec) * 1000000000u + static_cast<uint64_t>(st.st_mtimespec.tv_nsec);
+#else
+	stamp.mtime = static_cast<uint64_t>(st.st_mtim.tv_sec) * 1000000000u + static_cast<uint64_t>(st.st_mtim.tv_nsec);
+#endif
+	return true;
+}
+
+
+PathString absolutePath(const PathChar* pathFile) {
+	char buf[PATH_MAX];
+	return (realpath(pathFile, buf) ? buf : pathFile);
+}
+
+
+bool LinkCache::map(uint64_t size) {
+	struct stat st;
+	if(fstat(file, &st) != 0)   return false;
+	if(static_cast<uint64_t>(st.st_size) < size && ftruncate(file, static_cast<off_t>(size)) != 0)   return false;
+	void* p = mmap(nullptr, static_cast<size_t>(size), PROT_READ|PROT_WRITE, MAP_SHARED, file, 0);
+	if(p == MAP_FAILED)   return false;
+	view = static_cast<char*>(p);
+	mappedSize = size;
+	return true;
+}
+
+
+void LinkCache::unmap() {
+	if(view)   munmap(view, static_cast<size_t>(mappedSize));
+	view = nullptr;
+	mappedSize = 0;
+}
+
+
+namespace {
+	bool truncateFile(int file, uint64_t size) {
+		return ftruncate(file, static_cast<off_t>(size)) == 0;
+	}
+}
+
+
+bool LinkCache::openLocked(const PathChar* cacheFile, uint64_t& fileSize) {
+	if((file = ::open(cacheFile, O_RDWR|O_CREAT|O_CLOEXEC, 0644)) < 0)   return false;
+	struct stat st;
+	if(flock(file, LOCK_EX|LOCK_NB) != 0 || fstat(file, &st) != 0)   return false; // see the Windows version
+	fileSize = static_cast<uint64_t>(st.st_size);
+	return true;
+}
+
+#endif
+
+
+bool LinkCache::open(const PathChar* cacheFile) {
+	close();
+	uint64_t fileSize;
+	if(!openLocked(cacheFile, fileSize)) {
+		close();
+		return false;
+	}
+	// start a new cache if the file is empty or isn't one
+	if(fileSize >= sizeof(Header) && map(fileSize)) {
+		const Header& h = *reinterpret_cast<const Header*>(view);
+		if(std::memcmp(h.magic, cacheMagic, sizeof(cacheMagic)) == 0 && h.version == cacheVersion && h.pathCharSize == sizeof(PathChar) &&
+		   h.indexCapacity >= initialIndexCapacity && (h.indexCapacity & (h.indexCapacity - 1)) == 0 &&
+		   indexEnd(h.indexCapacity) <= h.dataEnd && h.dataEnd <= fileSize)   return true;
+	}
+	unmap();
+	if(!truncateFile(file, 0) || !map(indexEnd(initialIndexCapacity))) {
+		close();
+		return false;
+	}
+	std::memset(view, 0, static_cast<size_t>(mappedSize));
+	initHeader(*reinterpret_cast<Header*>(view), initialIndexCapacity);
+	return true;
+}
+
+
+void LinkCache::close() {
+	unmap();
+#ifdef _WIN32
+	if(file)   CloseHandle(file); // releases the lock
+	file = nullptr;
+#else
+	if(file >= 0)   ::close(file);
+	file = -1;
+#endif
+}
+
+
+int64_t LinkCache::findSlot(uint64_t hash, const PathChar* path, size_t pathLength) const {
+	const Header& h = *reinterpret_cast<const Header*>(view);
+	const Slot* slots = reinterpret_cast<const Slot*>(view + sizeof(Header));
+	const uint32_t mask = h.indexCapacity - 1;
+	uint32_t i = static_cast<uint32_t>(hash) & mask;
+	for(uint32_t n = 0;     n <= mask;     ++n, i = (i + 1) & mask) {
+		if(slots[i].offset == 0)   return i;
+		if(slots[i].hash != hash)   continue;
+		const Record* r = recordAt(view, mappedSize, slots[i].offset);
+		if(!r)   return i; // damaged, so it's replaced by the key's record
+		if(r->pathLength == pathLength && std::memcmp(r->path(), path, pathLength * sizeof(PathChar)) == 0)   return i;
+	}
+	return -1; // no empty slot left, nEntries is wrong
+}
+
+
+bool LinkCache::lookup(const PathString& absPath, const FileStamp& stamp, LinkFields& fields) {
+	std::lock_guard<std::mutex> lock(mutex);
+	if(!view)   return false;
+	const int64_t i = findSlot(hashPath(absPath.data(), absPath.size()), absPath.data(), absPath.size());
+	if(i < 0)   return false;
+	const Slot& slot = reinterpret_cast<const Slot*>(view + sizeof(Header))[i];
+	if(slot.offset == 0)   return false;
+	const Record* record = recordAt(view, mappedSize, slot.offset);
+	if(!record)   return false;
+	const Record& r = *record;
+	if(!(FileStamp{ r.fileSize, r.mtime } == stamp))   return false;
+	fields.flags   = r.flags;
+	fields.iconIdx = r.iconIdx;
+	const char16_t* p = r.fields();
+	for(int i = 0;     i < cachedFieldCount;     ++i)
+		if((fields.present[i] = (r.fieldLength[i] != missingField))) {
+			fields.value[i].assign(p, r.fieldLength[i]);
+			p += r.fieldLength[i];
+		} else fields.value[i].clear();
+	return true;
+}
+
+
+void LinkCache::store(const PathString& absPath, const FileStamp& stamp, const LinkFields& fields) {
+	std::lock_guard<std::mutex> lock(mutex);
+	if(!view)   return;
+	uint16_t length[cachedFieldCount];
+	uint64_t size = sizeof(Record) + absPath.size() * sizeof(PathChar);
+	for(int i = 0;     i < cachedFieldCount;     ++i) {
+		length[i] = (fields.present[i] ? static_cast<uint16_t>(std::min<size_t>(fields.value[i].size(), missingField - 1)) : missingField);
+		if(fields.present[i])   size += length[i] * sizeof(char16_t);
+	}
+	size = align8(size);
+	if(size > UINT32_MAX)   return; // absurd path, just don't cache it
+	const uint64_t hash = hashPath(absPath.data(), absPath.size());
+	int64_t i = findSlot(hash, absPath.data(), absPath.size());
+	Header* h = reinterpret_cast<Header*>(view);
+	const bool isNew = (i < 0 || reinterpret_cast<Slot*>(view + sizeof(Header))[i].offset == 0);
+	if(isNew && (i < 0 || tooFull(h->nEntries + 1, h->indexCapacity))) {
+		if(!rewrite(h->indexCapacity * 2, false))   return;
+		h = reinterpret_cast<Header*>(view);
+		if((i = findSlot(hash, absPath.data(), absPath.size())) < 0)   return;
+	}
+	if(h->dataEnd + size > mappedSize) { // grow the file geometrically, so appending stays cheap
+		const uint64_t dataEnd = h->dataEnd;
+		unmap();
+		if(!map(std::max(2 * dataEnd, dataEnd + size)))   return;
+		h = reinterpret_cast<Header*>(view);
+	}
+	Record& r = *reinterpret_cast<Record*>(view + h->dataEnd);
+	r.size       = static_cast<uint32_t>(size);
+	r.pathLength = static_cast<uint32_t>(absPath.size());
+	r.fileSize   = stamp.size;
+	r.mtime      = stamp.mtime;
+	r.flags      = fields.flags;
+	r.iconIdx    = fields.iconIdx;
+	std::memcpy(const_cast<PathChar*>(r.path()), absPath.data(), absPath.size() * sizeof(PathChar));
+	char16_t* p = const_cast<char16_t*>(r.fields());
+	for(int k = 0;     k < cachedFieldCount;     ++k) {
+		r.fieldLength[k] = length[k];
+		if(length[k] == missingField)   continue;
+		std::memcpy(p, fields.value[k].data(), length[k] * sizeof(char16_t));
+		p += length[k];
+	}
+	// the record is complete before it's entered into the index
+	Slot& slot = reinterpret_cast<Slot*>(view + sizeof(Header))[i];
+	slot.hash   = hash;
+	slot.offset = h->dataEnd;
+	h->dataEnd += size;
+	if(isNew)   ++h->nEntries;
+}
+
+
+/* Builds the new content in memory, then replaces the file content with it */
+bool LinkCache::rewrite(uint32_t indexCapacity, bool dropStale, size_t* nDropped) {
+	const Header& old = *reinterpret_cast<const Header*>(view);
+	const Slot* oldSlots = reinterpret_cast<const Slot*>(view + sizeof(Header));
+	std::vector<char> image(static_cast<size_t>(indexEnd(indexCapacity)), 0);
+	initHeader(*reinterpret_cast<Header*>(image.data()), indexCapacity);
+	uint32_t nEntries = 0;
+	size_t dropped = 0;
+	for(uint32_t k = 0;     k < old.indexCapacity;     ++k) {
+		if(oldSlots[k].offset == 0)   continue;
+		const Record* record = recordAt(view, mappedSize, oldSlots[k].offset);
+		if(!record) { // damaged
+			++dropped;
+			continue;
+		}
+		const Record& r = *record;
+		if(dropStale) {
+			FileStamp stamp;
+			if(!getFileStamp(PathString(r.path(), r.pathLength).c_str(), stamp) || !(stamp == FileStamp{ r.fileSize, r.mtime })) {
+				++dropped;
+				continue;
+			}
+		}
+		const size_t offset = image.size();
+		image.insert(image.end(), reinterpret_cast<const char*>(&r), reinterpret_cast<const char*>(&r) + r.size);
+		Slot* slots = reinterpret_cast<Slot*>(image.data() + sizeof(Header));
+		uint32_t i = static_cast<uint32_t>(oldSlots[k].hash) & (indexCapacity - 1);
+		while(slots[i].offset)     i = (i + 1) & (indexCapacity - 1); // the paths are all different
+		slots[i] = Slot{ oldSlots[k].hash, offset };
+		++nEntries;
+	}
+	Header& h = *reinterpret_cast<Header*>(image.data());
+	h.nEntries = nEntries;
+	h.dataEnd  = image.size();
+	unmap();
+	if(!truncateFile(file, image.size()) || !map(image.size())) {
+		close(); // the cache is unusable now, but the program can carry on without it
+		return false;
+	}
+	std::memcpy(view, image.data(), image.size());
+	if(nDropped)   *nDropped = dropped;
+	return true;
+}
+
+
+bool LinkCache::compact(size_t& nKept, size_t& nDropped) {
+	std::lock_guard<std::mutex> lock(mutex);
+	if(!view)   return false;
+	// the entries are counted rather than taken from nEntries, which may be wrong
+	const Header& h = *reinterpret_cast<const Header*>(view);
+	const Slot* slots = reinterpret_cast<const Slot*>(view + sizeof(Header));
+	uint32_t nEntries = 0, capacity = initialIndexCapacity;
+	for(uint32_t k = 0;     k < h.indexCapacity;     ++k)     nEntries += (slots[k].offset != 0);
+	while(tooFull(nEntries, capacity))     capacity *= 2;
+	if(!rewrite(capacity, true, &nDropped))   return false;
+	nKept = reinterpret_cast<const Header*>(view)->nEntries;
+	return true;
+}
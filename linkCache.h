@@ -0,0 +1,75 @@
+#pragma once
+#include "fileContent.h"
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+
+// The infos of a link file that are kept in the cache, all as UTF-16 strings
+enum struct CachedField {
+	TARGET, VOLUME_LABEL, DRIVE_TYPE, DRIVE_SERIAL,
+	NAME, RELPATH, WORKINGDIR, ARGUMENTS, ICONLOC,
+	MACHINE_ID, ENV_TARGET, KNOWN_FOLDER
+};
+constexpr int cachedFieldCount = 12;
+
+
+struct LinkFields {
+	uint32_t       flags   = 0;
+	uint32_t       iconIdx = 0;
+	bool           present[cachedFieldCount] = { };
+	std::u16string value[cachedFieldCount];
+	const std::u16string* get(CachedField f) const
+		{ return present[static_cast<int>(f)] ? &value[static_cast<int>(f)] : nullptr; }
+	void set(CachedField f, const char16_t* s, size_t n)
+		{ present[static_cast<int>(f)] = true;     value[static_cast<int>(f)].assign(s, n); }
+	void reset(CachedField f) { present[static_cast<int>(f)] = false;     value[static_cast<int>(f)].clear(); }
+	void clear() { for(int i = 0;     i < cachedFieldCount;     ++i)     { present[i] = false;     value[i].clear(); } }
+};
+
+
+// What identifies a version of a file: if size or modification time change, the cached infos are stale
+struct FileStamp {
+	uint64_t size  = 0;
+	uint64_t mtime = 0;
+	bool operator==(const FileStamp& s) const { return size == s.size && mtime == s.mtime; }
+};
+
+bool getFileStamp(const PathChar* pathFile, FileStamp& stamp); // without opening the file; false if it doesn't exist
+PathString absolutePath(const PathChar* pathFile);
+
+
+/* Persistent cache of link file infos, keyed by absolute path, size and modification time.
+   The cache file is memory mapped and consists of a header, an open addressing hash index (linear probing) and the
+   records, which are only ever appended: a changed link file gets a new record, and its index slot is pointed to it.
+   So a lookup is a stat of the link file plus a probe of the index, the link file itself isn't opened.
+   compact() rewrites the file without superseded records and without entries whose link file has changed or is gone.
+   The file is locked while it's open, and open() fails if another process has it open, so that process's callers go without
+   the cache instead of waiting for the first one to finish; the methods are thread safe. */
+class LinkCache {
+#ifdef _WIN32
+	void*    file = nullptr; // HANDLE
+#else
+	int      file = -1;
+#endif
+	char*    view = nullptr;
+	uint64_t mappedSize = 0;
+	std::mutex mutex;
+
+	bool openLocked(const PathChar* cacheFile, uint64_t& fileSize);
+	bool map(uint64_t size);
+	void unmap();
+	bool rewrite(uint32_t indexCapacity, bool dropStale, size_t* nDropped = nullptr);
+	int64_t findSlot(uint64_t hash, const PathChar* path, size_t pathLength) const; // the key's slot or the empty slot for it, -1 if there's neither
+public:
+	LinkCache() = default;
+	LinkCache(const LinkCache&) = delete;
+	LinkCache& operator=(const LinkCache&) = delete;
+	~LinkCache() { close(); }
+
+	bool open(const PathChar* cacheFile); // creates the file if it doesn't exist or isn't a cache; false on failure or if it's in use
+	void close();
+	bool lookup(const PathString& absPath, const FileStamp& stamp, LinkFields& fields);
+	void store(const PathString& absPath, const FileStamp& stamp, const LinkFields& fields);
+	bool compact(size_t& nKept, size_t& nDropped);
+};
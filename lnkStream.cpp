@@ -0,0 +1,171 @@
+#include "lnkStream.h"
+#include <algorithm>
+#include <cstring>
+
+namespace {
+	const LNK_error errInLNK{ LNK_error::BROKEN };
+
+	uint32_t read32(const char* p) { uint32_t v;     std::memcpy(&v, p, sizeof(v));     return v; }
+	uint16_t read16(const char* p) { uint16_t v;     std::memcpy(&v, p, sizeof(v));     return v; }
+
+	// the flags of the StringData strings, indexed by StringItem
+	constexpr Flag stringFlags[]{ HasName, HasRelativePath, HasWorkingDir, HasArguments, HasIconLocation };
+}
+
+
+void LinkStreamParser::reset() {
+	flags = 0;
+	stringIndex = 0;
+	offset_ = 0;
+	expect(State::HEADER, LinkHeader::size);
+}
+
+
+size_t LinkStreamParser::feed(const char* data, size_t n) {
+	const char* p = data;
+	while(state != State::DONE) {
+		const char* item = collect(p, data + n);
+		if(!item)   break; // the rest comes with the next chunk
+		advance(item);
+	}
+	offset_ += static_cast<size_t>(p - data);
+	return static_cast<size_t>(p - data);
+}
+
+
+void LinkStreamParser::finish() {
+	if(state == State::DONE)   return;
+	// like ExtraDataIndex, the ExtraData section may end without a TerminalBlock
+	if(state != State::EXTRA_SIZE)   throw errInLNK;
+	state = State::DONE;
+}
+
+
+// Takes what [p, end) has of the current item; the item once it's complete, otherwise nullptr
+const char* LinkStreamParser::collect(const char*& p, const char* end) {
+	if(have == 0)   inChunk = p;
+	const size_t n = std::min(need - have, static_cast<size_t>(end - p));
+	if(inChunk) {
+		if(n == need - have) { // it's all in this chunk
+			p += n;
+			have = need;
+			return inChunk;
+		}
+		if(keep)   carry.assign(inChunk, end); // it goes on in the next chunk
+		inChunk = nullptr;
+	} else if(keep)   carry.insert(carry.end(), p, p + n);
+	p += n;
+	have += n;
+	if(have < need)   return nullptr;
+	return (keep ? carry.data() : p); // a skipped item is only there to be passed over
+}
+
+
+void LinkStreamParser::expect(State next, size_t size, bool keep) {
+	state = next;
+	need = size;
+	have = 0;
+	this->keep = keep;
+	inChunk = nullptr;
+	carry.clear();
+}
+
+
+void LinkStreamParser::grow(size_t size, uint32_t part) {
+	need = size;
+	keep = (parts & part) != 0;
+	if(keep && size > maxSectionSize)   throw errInLNK;
+}
+
+
+// The next section is LinkTargetIDList, or whatever comes after it if the file doesn't have it
+void LinkStreamParser::startIDList() {
+	if(!wanted(PART_LINKTARGETIDLIST))   state = State::DONE;
+	else if(flags & HasLinkTargetIDList)   expect(State::IDLIST_SIZE, 2);
+	else startLinkInfo();
+}
+
+
+void LinkStreamParser::startLinkInfo() {
+	if(!wanted(PART_LINKINFO))   state = State::DONE;
+	else if(flags & HasLinkInfo)   expect(State::LINKINFO_SIZE, 4);
+	else startString(0);
+}
+
+
+// The next section is the first string from the StringItem from on that the file has, or the ExtraData after the last one
+void LinkStreamParser::startString(int from) {
+	for(int i = from;     i < 5;     ++i) {
+		if(!wanted(stringPart(static_cast<StringItem>(i)))) {
+			state = State::DONE;
+			return;
+		}
+		if(flags & stringFlags[i]) {
+			stringIndex = i;
+			expect(State::STRING_LENGTH, 2);
+			return;
+		}
+	}
+	if(wanted(PART_EXTRADATA))   expect(State::EXTRA_SIZE, 4);
+	else                         state = State::DONE;
+}
+
+
+// The current item is complete
+void LinkStreamParser::advance(const char* item) {
+	switch(state) {
+	case State::HEADER: {
+		const LinkHeader header(item, item + need);
+		flags = header.flags;
+		handler.header(header);
+		startIDList();
+		return;
+	}
+	case State::IDLIST_SIZE:
+		grow(2 + read16(item), PART_LINKTARGETIDLIST);
+		state = State::IDLIST;
+		return;
+	case State::IDLIST:
+		if(keep)   handler.linkTargetIDList(item, item + need);
+		startLinkInfo();
+		return;
+	case State::LINKINFO_SIZE:
+		if(read32(item) < 4)   throw errInLNK;
+		grow(read32(item), PART_LINKINFO);
+		state = State::LINKINFO;
+		return;
+	case State::LINKINFO:
+		if(keep)   handler.linkInfo(item, item + need);
+		startString(0);
+		return;
+	case State::STRING_LENGTH:
+		grow(2 + read16(item) * (flags & IsUnicode ? sizeof(char16_t) : sizeof(char)), stringPart(static_cast<StringItem>(stringIndex)));
+		state = State::STRING;
+		return;
+	case State::STRING:
+		if(keep) {
+			StringRef s;
+			s.data      = item + 2;
+			s.length    = read16(item);
+			s.isUnicode = (flags & IsUnicode) != 0;
+			handler.string(static_cast<StringItem>(stringIndex), s);
+		}
+		startString(stringIndex + 1);
+		return;
+	case State::EXTRA_SIZE:
+		if(read32(item) < 4) { // TerminalBlock
+			state = State::DONE;
+			return;
+		}
+		if(read32(item) < 8)   throw errInLNK;
+		grow(read32(item), PART_EXTRADATA);
+		state = State::EXTRA;
+		return;
+	case State::EXTRA:
+		if(keep)   handler.extraData(ExtraDataBlock{ static_cast<ExtraDataSignature>(read32(item + 4)), item, static_cast<uint32_t>(need) });
+		expect(State::EXTRA_SIZE, 4);
+		return;
+	case State::DONE:
+		return;
+	}
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include "lnkparse.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+
+/* Incremental parsing of a link file that arrives in chunks of any size, e.g. out of an archive or a pipe, without ever having
+   all of it in memory. The parser is fed the chunks in order and reports every section as soon as it is complete: the header,
+   then LinkTargetIDList, LinkInfo, the StringData strings and the ExtraData blocks in file order.
+   A section that lies within one chunk is reported in place; only one that spans chunks is copied, into a buffer that holds
+   nothing but the section being collected. Sections of parts that weren't requested are skipped without being copied, and
+   after the last requested part the parser is done and consumes no more.
+   The pointers a Handler gets are only valid during the call: construct LinkTargetIDList, LinkInfo or the ExtraData block
+   structs from them there, and copy what should be kept. */
+class LinkStreamParser {
+public:
+	struct Handler {
+		virtual ~Handler() = default;
+		virtual void header(const LinkHeader&) { }
+		virtual void linkTargetIDList(const char* /*begin*/, const char* /*end*/) { } // from its IDListSize field on
+		virtual void linkInfo(const char* /*begin*/, const char* /*end*/) { }
+		virtual void string(StringItem, const StringRef&) { }
+		virtual void extraData(const ExtraDataBlock&) { }
+	};
+
+	static constexpr size_t maxSectionSize = 1024 * 1024; // a requested section bigger than that is taken as broken
+
+	explicit LinkStreamParser(Handler& handler, uint32_t parts = ALL_PARTS) : handler(handler), parts(parts) { reset(); }
+	void reset(); // for the next link file
+
+	/* Parses on with the next n bytes of the file; returns how many of them were used, which is n unless the parser is done.
+	   Throws LNK_error if the file is broken. */
+	size_t feed(const char* data, size_t n);
+	// The file has ended; throws LNK_error if that was in the middle of a section
+	void finish();
+	bool     done()   const { return state == State::DONE; }
+	uint64_t offset() const { return offset_; } // how much of the file has been used
+
+private:
+	enum struct State { HEADER, IDLIST_SIZE, IDLIST, LINKINFO_SIZE, LINKINFO, STRING_LENGTH, STRING, EXTRA_SIZE, EXTRA, DONE };
+	Handler& handler;
+	uint32_t parts;
+	State    state;
+	uint32_t flags;
+	int      stringIndex;       // the StringItem of STRING_LENGTH and STRING
+	size_t   need;              // the size of the item being collected, e.g. of a section from its size field on
+	size_t   have;              // how much of it has been collected (or skipped)
+	bool     keep;              // whether it's collected or skipped
+	const char* inChunk;        // where it starts in the current chunk, nullptr if it's in carry
+	std::vector<char> carry;    // the item, if it started in an earlier chunk
+	uint64_t offset_;
+
+	const char* collect(const char*& p, const char* end);
+	void expect(State next, size_t size, bool keep = true);
+	void grow(size_t size, uint32_t part); // the item is longer than its size field, and kept if part is requested
+	void startIDList();
+	void startLinkInfo();
+	void startString(int from);
+	bool wanted(uint32_t part) const { return (parts & ~(part - 1)) != 0; } // whether this or any later part is requested
+	void advance(const char* item);
+};
@@ -0,0 +1,193 @@
+#include "lnkparse.h"
+#include "unaligned.h"
+#include <cstring>
+#include <utility>
+
+namespace {
+	const LNK_error errInLNK{ LNK_error::BROKEN };
+}
+
+
+ItemID::ItemID(const char *begin, const char* limit) : dataBegin(begin + 2), dataEnd(begin + read16(begin)) {
+	if(dataEnd > limit || dataEnd < dataBegin)   throw errInLNK;
+}
+
+
+LinkTargetIDList::LinkTargetIDList(const char* begin, const char* limit, ParseContext* context) {
+	if(limit - begin < 2)   throw errInLNK;
+	const uint16_t listSize = read16(begin);
+	begin += 2;
+	if(listSize > limit - begin)   throw errInLNK;
+	afterwards = begin + listSize;
+	size_t n = 0; // the items are counted first, so a long list is allocated once
+	for(const char* p = begin;     afterwards - p >= 2 && read16(p);     p += read16(p))     ++n;
+	if(n > 8) {
+		if(context)   data.useStorage(context->allocateArray<ItemID>(n), n);
+		else          data.reserve(n);
+	}
+	// every ItemID ends within the list, and the list with the TerminalID
+	for(;;) {
+		if(afterwards - begin < 2)   throw errInLNK;
+		if(!read16(begin))   break;
+		data.emplace_back(begin, afterwards);
+		begin = data.back().dataEnd;
+	}
+	if((begin += 2) != afterwards)   throw errInLNK;
+}
+
+
+/* The content may be anything, e.g. bytes of a disk image that only look like a link file, so every offset and size is checked
+   against the LinkInfo before it's used */
+LinkInfo::LinkInfo(const char* begin, const char* limit, ParseContext* context) {
+	if(limit - begin < 12)   throw errInLNK;
+	const uint32_t size = read32(begin), headerSize = read32(begin + 4);
+	if(size > static_cast<size_t>(limit - begin))   throw errInLNK;
+	afterwards = begin + size;
+	// the offsets of VolumeID, LocalBasePath, CommonNetworkRelativeLink and CommonPathSuffix, and of the Unicode paths if the header has them
+	const unsigned int nItems = (headerSize < 0x24 ? 4 : 6);
+	if(headerSize < 0x1C || headerSize > size || 12 + 4 * nItems > size)   throw errInLNK;
+	linkInfoFlags = static_cast<LinkInfoFlags>(read32(begin + 8));
+	const char* itemPointers[6]{ nullptr };
+	for(unsigned int i = 0;     i < nItems;     ++i) {
+		const uint32_t offset = read32(begin + 12 + 4 * i);
+		if(offset >= size || (i >= 4 && size - offset < sizeof(char16_t)))   throw errInLNK; // the Unicode paths have room for a character
+		itemPointers[i] = begin + offset;
+	}
+	if((int)linkInfoFlags & (int)LinkInfoFlags::VolumeIDAndLocalBasePath) {
+		// VolumeIDSize, DriveType, DriveSerialNumber, VolumeLabelOffset and, if that is 0x14, VolumeLabelOffsetUnicode
+		const char* v = itemPointers[0];
+		const size_t available = static_cast<size_t>(afterwards - v);
+		if(available < 16)   throw errInLNK;
+		const uint32_t volumeIDsize = read32(v);
+		if(volumeIDsize < 16 || volumeIDsize > available)   throw errInLNK;
+		const uint32_t driveType = read32(v + 4);
+		if(driveType >= static_cast<uint32_t>(driveTypeCount))   throw errInLNK;
+		volumeID = makeParsed<VolumeIDandBasePath>(context);
+		volumeID->driveType    = static_cast<int>(driveType);
+		volumeID->serialNumber = read32(v + 8);
+		const uint32_t labelOffset = read32(v + 12);
+		if(!(volumeID->volumeLabelIsUnicode = (labelOffset == 0x14))) {
+			if(labelOffset >= available)   throw errInLNK;
+			volumeID->volumeLabel = v + labelOffset;
+		} else {
+			if(volumeIDsize < 20)   throw errInLNK;
+			const uint32_t labelOffsetUC = read32(v + 16);
+			if(labelOffsetUC >= available || available - labelOffsetUC < sizeof(char16_t))   throw errInLNK;
+			volumeID->volumeLabelUC = reinterpret_cast<const char16_t*>(v + labelOffsetUC);
+		}
+		volumeID->localBasePath   = itemPointers[1];
+		volumeID->localBasePathUC = reinterpret_cast<const char16_t*>(itemPointers[4]);
+	}
+	//CommonNetworkRelativeLinkOffset <=> itemPointers[2]
+	commonPathSuffix = itemPointers[3];
+	commonPathSuffixUC = reinterpret_cast<const char16_t*>(itemPointers[5]);
+}
+
+
+
+LinkHeader::LinkHeader(const char* begin, const char* end) {
+	if(end - begin < static_cast<ptrdiff_t>(size))   throw errInLNK;
+	read(begin);
+}
+
+
+void LinkHeader::read(const char* begin) {
+	constexpr static uint32_t magic[] = { 76, 0x00021401, 0, 0xC0, 0x46000000 }; // HeaderSize and LinkCLSID
+	if(std::memcmp(begin, magic, sizeof(magic)) != 0)   throw LNK_error(LNK_error::WRONG_HEADER);
+	// the times are at offsets that aren't a multiple of 8
+	std::memcpy(&flags,          begin + 20, 4);
+	std::memcpy(&fileAttributes, begin + 24, 4);
+	std::memcpy(&creationTime,   begin + 28, 8);
+	std::memcpy(&accessTime,     begin + 36, 8);
+	std::memcpy(&writeTime,      begin + 44, 8);
+	std::memcpy(&fileSize,       begin + 52, 4);
+	std::memcpy(&iconIdx,        begin + 56, 4);
+	std::memcpy(&showCommand,    begin + 60, 4);
+	std::memcpy(&hotKey,         begin + 64, 2);
+}
+
+
+LNKView::LNKView(const char* begin, const char* end, uint32_t parts, size_t fileSize) {
+	const char* const fileBegin = begin;
+	const size_t contentSize = static_cast<size_t>(end - begin);
+	if(fileSize < contentSize)   fileSize = contentSize;
+	// Content ending before p is broken, unless the content is just the beginning of a longer file
+	auto available = [&](const char* p) {
+		const size_t n = static_cast<size_t>(p - fileBegin);
+		if(n <= contentSize)   return true;
+		if(n > fileSize)   throw errInLNK;
+		prefixNeeded = n;
+		return false;
+	};
+	// whether any of the parts from this one on are requested; the LNKPart values are in file order
+	auto wanted = [parts](uint32_t part) { return (parts & ~(part - 1)) != 0; };
+	if(!available(begin + size))   return;
+	read(begin);
+	begin += size;
+	if(!wanted(PART_LINKTARGETIDLIST))   return;
+	if(flags & HasLinkTargetIDList) {
+		if(!available(begin + 2))   return;
+		linkTargetIDList = begin;
+		begin += 2 + read16(begin);
+		if(!available(begin))   return;
+	}
+	if(!wanted(PART_LINKINFO))   return;
+	if(flags & HasLinkInfo) {
+		if(!available(begin + 4))   return;
+		const uint32_t linkInfoSize = read32(begin);
+		if(linkInfoSize < 4)   throw errInLNK;
+		linkInfo = begin;
+		begin += linkInfoSize;
+		if(!available(begin))   return;
+	}
+	const bool isUnicode = (flags & IsUnicode) != 0;
+	for(auto& p : { std::make_pair(HasName,         StringItem::NAMESTRING),
+	                std::make_pair(HasRelativePath, StringItem::RELPATH),
+	                std::make_pair(HasWorkingDir,   StringItem::WORKINGDIR),
+	                std::make_pair(HasArguments,    StringItem::COMMANDLINE),
+	                std::make_pair(HasIconLocation, StringItem::ICONLOC) }) {
+		if(!wanted(stringPart(p.second)))   return;
+		if(flags & p.first) {
+			if(!available(begin + 2))   return;
+			StringRef& s = strings[static_cast<int>(p.second)];
+			s.length    = read16(begin);
+			begin      += 2;
+			s.isUnicode = isUnicode;
+			s.data      = begin;
+			if(!available(begin += s.sizeInBytes())) { // the content may be a mapped file, so don't read past its end
+				s = StringRef();
+				return;
+			}
+		}
+	}
+	afterwards = begin;
+	// the ExtraData section has no size of its own, it extends until the TerminalBlock, which is normally the end of the file
+	if((parts & PART_EXTRADATA) && fileSize > contentSize)   prefixNeeded = fileSize;
+}
+
+
+
+CopiedString::CopiedString(const StringRef& s, ParseContext* context) : size_(s.sizeInBytes()) {
+	char* p;
+	if(context)   p = context->allocateArray<char>(size_ + 2);
+	else          heap.reset(p = new char[size_ + 2]);
+	std::memcpy(p, s.data, size_);
+	p[size_] = p[size_ + 1] = '\0';
+	data = p;
+}
+
+
+LNK::LNK(const char* begin, const char* end, uint32_t parts, ParseContext* context) : LNK(LNKView(begin, end, parts), end, parts, context) { }
+
+
+LNK::LNK(const LNKView& view, const char* end, uint32_t parts, ParseContext* context) : LinkHeader(view) {
+	if(view.linkTargetIDList && (parts & PART_LINKTARGETIDLIST))   linkTargetIDList = makeParsed<LinkTargetIDList>(context, view.linkTargetIDList, end, context);
+	if(view.linkInfo && (parts & PART_LINKINFO))                   linkInfo         = makeParsed<LinkInfo>(context, view.linkInfo, end, context);
+	for(auto& p : { std::make_pair(StringItem::NAMESTRING,  &nameString),
+	                std::make_pair(StringItem::RELPATH,     &relPath),
+	                std::make_pair(StringItem::WORKINGDIR,  &workingDir),
+	                std::make_pair(StringItem::COMMANDLINE, &commandLine),
+	                std::make_pair(StringItem::ICONLOC,     &iconLoc) })
+		if(const StringRef& s = view.string(p.first))
+			if(parts & stringPart(p.first))   *p.second = CopiedString(s, context);
+}
@@ -0,0 +1,327 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <stdexcept>
+#include <vector>
+#include <memory>
+#include "parseContext.h"
+#include "smallVector.h"
+
+/* Parser for Microsoft Shell Link (.lnk) files. It works on a buffer holding the file content and has no
+   platform dependency; UTF-16 strings are char16_t regardless of the size of wchar_t. */
+
+
+struct LNK_error : std::runtime_error {
+	enum Cause { BROKEN, WRONG_HEADER } cause;
+	explicit LNK_error(Cause cause) : std::runtime_error(cause == WRONG_HEADER ? "Wrong file header - not a proper .lnk file" : "Linkfile is broken"), cause(cause) { }
+};
+
+
+enum Flag : uint32_t {
+	HasLinkTargetIDList         = 1,
+	HasLinkInfo                 = 1 <<  1,
+	HasName                     = 1 <<  2,
+	HasRelativePath             = 1 <<  3,
+	HasWorkingDir               = 1 <<  4,
+	HasArguments                = 1 <<  5,
+	HasIconLocation             = 1 <<  6,
+	IsUnicode                   = 1 <<  7,
+	ForceNoLinkInfo             = 1 <<  8,
+	HasExpString                = 1 <<  9,
+	RunInSeparateProces         = 1 << 10,
+	HasDarwinID                 = 1 << 12,
+	RunAsUser                   = 1 << 13,
+	HasExpIcon                  = 1 << 14,
+	NoPidlAlias                 = 1 << 15,
+	RunWithShimLayer            = 1 << 17,
+	ForceNoLinkTrack            = 1 << 18,
+	EnableTargetMetadata        = 1 << 19,
+	DisableLinkPathTracking     = 1 << 20,
+	DisableKnownFolderTracking  = 1 << 21,
+	DisableKnownFolderAlias     = 1 << 22,
+	AllowLinkToLink             = 1 << 23,
+	UnaliasOnSave               = 1 << 24,
+	PreferEnvironmentPath       = 1 << 25,
+	KeepLocalIDListForUNCTarget = 1 << 26
+};
+
+struct FlagName {
+	Flag        flag;
+	const char* name;
+};
+
+constexpr FlagName flagNames[]{
+	{ HasLinkTargetIDList, "HasLinkTargetIDList" }, { HasLinkInfo, "HasLinkInfo" }, { HasName, "HasName" },
+	{ HasRelativePath, "HasRelativePath" }, { HasWorkingDir, "HasWorkingDir" }, { HasArguments, "HasArguments" },
+	{ HasIconLocation, "HasIconLocation" }, { IsUnicode, "IsUnicode" }, { ForceNoLinkInfo, "ForceNoLinkInfo" },
+	{ HasExpString, "HasExpString" }, { RunInSeparateProces, "RunInSeparateProcess" }, { HasDarwinID, "HasDarwinID" },
+	{ RunAsUser, "RunAsUser" }, { HasExpIcon, "HasExpIcon" }, { NoPidlAlias, "NoPidlAlias" },
+	{ RunWithShimLayer, "RunWithShimLayer" }, { ForceNoLinkTrack, "ForceNoLinkTrack" },
+	{ EnableTargetMetadata, "EnableTargetMetadata" }, { DisableLinkPathTracking, "DisableLinkPathTracking" },
+	{ DisableKnownFolderTracking, "DisableKnownFolderTracking" }, { DisableKnownFolderAlias, "DisableKnownFolderAlias" },
+	{ AllowLinkToLink, "AllowLinkToLink" }, { UnaliasOnSave, "UnaliasOnSave" }, { PreferEnvironmentPath, "PreferEnvironmentPath" },
+	{ KeepLocalIDListForUNCTarget, "KeepLocalIDListForUNCTarget" }
+};
+
+
+// FILE_ATTRIBUTE_* of WinNT.h, as far as a link file records them for its target
+struct AttributeName {
+	uint32_t    attribute;
+	const char* name;
+};
+
+constexpr AttributeName fileAttributeNames[]{
+	{ 0x0001, "ReadOnly" }, { 0x0002, "Hidden" }, { 0x0004, "System" }, { 0x0010, "Directory" },
+	{ 0x0020, "Archive" }, { 0x0080, "Normal" }, { 0x0100, "Temporary" }, { 0x0200, "SparseFile" },
+	{ 0x0400, "ReparsePoint" }, { 0x0800, "Compressed" }, { 0x1000, "Offline" },
+	{ 0x2000, "NotContentIndexed" }, { 0x4000, "Encrypted" }
+};
+
+// the ShowCommand values a link file may have (SW_* of WinUser.h); any other is taken as SW_SHOWNORMAL
+enum ShowCommand : uint32_t { SHOW_NORMAL = 1, SHOW_MAXIMIZED = 3, SHOW_MINNOACTIVE = 7 };
+
+
+/* The fixed size ShellLinkHeader at the beginning of every link file (MS-SHLLNK 2.1). The times are FILETIMEs,
+   i.e. 100 ns intervals since 1601-01-01 UTC, 0 if not set; attributes, times and size are those of the target
+   when the link was last saved. */
+struct LinkHeader {
+	static constexpr size_t size = 76;
+	uint32_t flags          = 0;
+	uint32_t fileAttributes = 0;
+	uint64_t creationTime   = 0;
+	uint64_t accessTime     = 0;
+	uint64_t writeTime      = 0;
+	uint32_t fileSize       = 0; // the lower 32 bits
+	uint32_t iconIdx        = 0;
+	uint32_t showCommand    = 0;
+	uint16_t hotKey         = 0; // virtual key code in the low byte, HOTKEYF_* modifiers in the high byte
+	LinkHeader() = default;
+	// just the header, so [begin, end) may be the first size bytes of the file; throws LNK_error if it isn't a link file
+	LinkHeader(const char* begin, const char* end);
+protected:
+	void read(const char* begin); // of size bytes
+};
+
+
+// indexed by the drive type values defined in WinBase.h
+constexpr const char* driveTypeNames[]
+	{ "DRIVE_UNKNOWN", "DRIVE_NO_ROOT_DIR", "DRIVE_REMOVABLE", "DRIVE_FIXED", "DRIVE_REMOTE", "DRIVE_CDROM", "DRIVE_RAMDISK" };
+constexpr int driveTypeCount = static_cast<int>(sizeof(driveTypeNames) / sizeof(*driveTypeNames));
+
+
+struct VolumeIDandBasePath {
+	int driveType; // as defined in WinBase.h
+	uint32_t  serialNumber;
+	bool volumeLabelIsUnicode;
+	union {
+		const char*     volumeLabel;
+		const char16_t* volumeLabelUC;
+	};
+	const char*     localBasePath;
+	const char16_t* localBasePathUC;
+};
+
+
+enum struct LinkInfoFlags : uint32_t {
+	VolumeIDAndLocalBasePath = 1,
+	CommonNetworkRelativeLinkAndPathSuffix = 2
+};
+
+
+struct ItemID {
+	const char *dataBegin, *dataEnd;
+	ItemID(const char *begin, const char* limit);
+	ItemID() = default;
+	ItemID(const ItemID&) = default;
+	uint8_t type() const { return (dataBegin < dataEnd ? static_cast<uint8_t>(*dataBegin) : 0); } // the shell item class
+};
+
+
+/* The ItemIDs are only located when the list is constructed; most lists have a handful of them, which fit inline.
+   path() decodes them: it reconstructs the target path from the root folder (a CLSID), volume, network location
+   and file entry shell items, taking the long names of file entries from their BEEF0004 extension blocks.
+   That is the only target path links without LinkInfo have, e.g. those to Control Panel items and known folders.
+   Shell folders other than My Computer become ::{CLSID}, like in shell parsing names; the result is empty if the
+   list contains an item of another type. */
+struct LinkTargetIDList {
+	SmallVector<ItemID, 8> data;
+	const char* afterwards;
+	LinkTargetIDList(const char* begin, const char* limit, ParseContext* context = nullptr); // longer lists go into the context
+	std::u16string path() const;
+};
+
+
+struct LinkInfo {
+	LinkInfoFlags linkInfoFlags;
+	ParsePtr<VolumeIDandBasePath> volumeID;
+	const char*     commonPathSuffix;
+	const char16_t* commonPathSuffixUC;
+	const char* afterwards;
+	LinkInfo(const char* begin, const char* limit, ParseContext* context = nullptr);
+};
+
+
+enum struct StringItem { NAMESTRING, RELPATH, WORKINGDIR, COMMANDLINE, ICONLOC };
+
+
+// A StringData string as it is stored in the link file: length-prefixed, not terminated
+struct StringRef {
+	const char* data = nullptr; // nullptr if the string isn't present
+	uint16_t    length = 0;     // in characters
+	bool        isUnicode = false;
+	explicit operator bool() const { return data != nullptr; }
+	const char16_t* dataUC() const { return reinterpret_cast<const char16_t*>(data); }
+	size_t sizeInBytes() const { return length * (isUnicode ? sizeof(char16_t) : sizeof(char)); }
+};
+
+
+/* The parts of a link file a caller is interested in, in the order they are stored in the file.
+   Parsing stops as soon as the last requested part has been located. */
+enum LNKPart : uint32_t {
+	PART_LINKTARGETIDLIST = 1,
+	PART_LINKINFO         = 1 << 1,
+	PART_NAMESTRING       = 1 << 2, // the StringData strings in StringItem order
+	PART_RELPATH          = 1 << 3,
+	PART_WORKINGDIR       = 1 << 4,
+	PART_COMMANDLINE      = 1 << 5,
+	PART_ICONLOC          = 1 << 6,
+	PART_EXTRADATA        = 1 << 7,
+	PART_HEADER           = 0,      // the LinkHeader fields are always there
+	ALL_PARTS             = (1 << 8) - 1
+};
+
+inline uint32_t stringPart(StringItem item) { return PART_NAMESTRING << static_cast<int>(item); }
+
+
+/* Non-owning view of a link file: nothing is allocated or copied, everything points into the file content,
+   so a LNKView is only valid as long as that content lives. LinkTargetIDList and LinkInfo are merely located,
+   construct them from linkTargetIDList/linkInfo when needed.
+   Sections are skipped by their size fields; parts after the last requested one are not looked at, so they are
+   missing from the view. Parts before it may be located as a by-product.
+   If fileSize is bigger than the content, the content is taken to be just the beginning of the file. Should the
+   requested parts not lie completely within it, prefixNeeded is set to the number of bytes at the beginning of
+   the file that are needed at least, and the view must be constructed again once they are available. */
+struct LNKView : LinkHeader {
+	const char* linkTargetIDList = nullptr; // start of the section, nullptr if not present
+	const char* linkInfo         = nullptr;
+	StringRef   strings[5];                 // indexed by StringItem
+	const char* afterwards       = nullptr; // end of the StringData section, nullptr if parsing stopped earlier
+	size_t      prefixNeeded     = 0;
+	LNKView() = default; // an empty view, to be assigned
+	LNKView(const char* begin, const char* end, uint32_t parts = ALL_PARTS, size_t fileSize = 0);
+	const StringRef& string(StringItem item) const { return strings[static_cast<int>(item)]; }
+};
+
+
+/* A StringData string copied out of the file content, terminated by two zero bytes, so a wide string is terminated too */
+class CopiedString {
+	std::unique_ptr<char[]> heap; // nullptr if the characters are in a ParseContext
+	const char* data  = nullptr;
+	size_t      size_ = 0;
+public:
+	CopiedString() = default;
+	CopiedString(const StringRef& s, ParseContext* context);
+	explicit operator bool() const { return data != nullptr; }
+	const char* c_str() const { return data; }
+	size_t      size()  const { return size_; } // in bytes, without the terminator
+};
+
+
+/* Owning version of LNKView for when the results must outlive the file content.
+   Note that the strings of LinkInfo still point into the content.
+   With a ParseContext everything is allocated from it, so the LNK must be gone before the context is reset. */
+struct LNK : LinkHeader {
+	ParsePtr<LinkTargetIDList> linkTargetIDList;
+	ParsePtr<LinkInfo>         linkInfo;
+	CopiedString nameString, relPath, workingDir, commandLine, iconLoc;
+	LNK(const char* begin, const char* end, uint32_t parts = ALL_PARTS, ParseContext* context = nullptr); // parts not requested stay empty
+	LNK(const LNKView& view, const char* end, uint32_t parts = ALL_PARTS, ParseContext* context = nullptr);
+};
+
+
+/* ExtraData section (MS-SHLLNK 2.5), which follows the StringData section, i.e. starts at LNKView::afterwards */
+
+enum struct ExtraDataSignature : uint32_t {
+	ENVIRONMENT_VARIABLE = 0xA0000001,
+	CONSOLE              = 0xA0000002,
+	TRACKER              = 0xA0000003,
+	CONSOLE_FE           = 0xA0000004,
+	SPECIAL_FOLDER       = 0xA0000005,
+	DARWIN               = 0xA0000006,
+	ICON_ENVIRONMENT     = 0xA0000007,
+	SHIM                 = 0xA0000008,
+	PROPERTY_STORE       = 0xA0000009,
+	KNOWN_FOLDER         = 0xA000000B,
+	VISTA_AND_ABOVE_IDLIST = 0xA000000C
+};
+
+
+struct ExtraDataBlock {
+	ExtraDataSignature signature;
+	const char* begin; // start of the block, i.e. of its BlockSize field
+	uint32_t    size;
+	const char* data() const { return begin + 8; } // after BlockSize and BlockSignature
+	const char* end()  const { return begin + size; }
+};
+
+
+/* Locates the ExtraData blocks by walking over their headers only; no block is decoded. That is left to the
+   block structs below, which are constructed from an ExtraDataBlock when that block is actually asked for. */
+struct ExtraDataIndex {
+	static constexpr int maxBlocks = 16; // every block type may occur only once, so this is plenty
+	ExtraDataBlock blocks[maxBlocks];
+	int nBlocks = 0;
+	ExtraDataIndex() = default;
+	ExtraDataIndex(const char* begin, const char* end);
+	const ExtraDataBlock* find(ExtraDataSignature signature) const;
+};
+
+
+struct GUID_t {
+	uint32_t data1;
+	uint16_t data2, data3;
+	uint8_t  data4[8];
+	explicit GUID_t(const char* p);
+	std::string toString() const; // {xxxxxxxx-xxxx-xxxx-xxxx-xxxxxxxxxxxx}
+};
+
+
+struct TrackerDataBlock {
+	const char* machineID;       // NetBIOS name of the machine the link target was last seen on, not necessarily terminated
+	size_t      machineIDLength;
+	GUID_t volumeDroid, fileDroid, birthVolumeDroid, birthFileDroid;
+	explicit TrackerDataBlock(const ExtraDataBlock& block);
+};
+
+
+// Used by links to targets with environment variables in their path, e.g. %ProgramFiles%
+struct EnvironmentVariableDataBlock {
+	const char*     target;         // ANSI, not necessarily terminated
+	size_t          targetLength;
+	const char16_t* targetUC;       // Unicode, targetLengthUC == 0 if the field is empty
+	size_t          targetLengthUC;
+	explicit EnvironmentVariableDataBlock(const ExtraDataBlock& block);
+};
+
+
+struct KnownFolderDataBlock {
+	GUID_t   knownFolderID;
+	uint32_t offset; // of the ItemID in the LinkTargetIDList that refers to the known folder
+	explicit KnownFolderDataBlock(const ExtraDataBlock& block);
+};
+
+
+struct SpecialFolderDataBlock {
+	uint32_t specialFolderID; // CSIDL
+	uint32_t offset;          // of the ItemID in the LinkTargetIDList that refers to the special folder
+	explicit SpecialFolderDataBlock(const ExtraDataBlock& block);
+};
+
+
+// The serialized property storages (MS-PROPSTORE) are only located, not decoded
+struct PropertyStoreDataBlock {
+	const char* begin;
+	const char* end;
+	explicit PropertyStoreDataBlock(const ExtraDataBlock& block) : begin(block.data()), end(block.end()) { }
+};
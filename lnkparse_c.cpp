@@ -0,0 +1,259 @@
+#include "lnkparse_c.h"
+#include "lnkparse.h"
+#include "unaligned.h"
+#include "utf8.h"
+#include <new>
+
+
+struct lnk_file {
+	LNKView view;
+	const char* end;
+	std::unique_ptr<LinkInfo> linkInfo;
+	ExtraDataIndex extraData;
+	bool extraDataBroken = false; // only the ExtraData fields are unavailable then
+	lnk_file(const char* begin, const char* end) : view(begin, end), end(end) {
+		if(view.linkInfo)   linkInfo = std::make_unique<LinkInfo>(view.linkInfo, end);
+		try {
+			extraData = ExtraDataIndex(view.afterwards, end);
+		}
+		catch(const LNK_error&) {   extraDataBroken = true;   }
+	}
+};
+
+
+namespace {
+
+struct RawString {
+	const char* data = nullptr;
+	size_t length = 0; // in code units
+	bool isUnicode = false;
+};
+
+
+// LinkInfo strings are zero terminated; don't look for the terminator beyond the end of LinkInfo
+template<typename C>
+size_t boundedLength(const C* s, const char* limit) {
+	const C* p = s;
+	while(reinterpret_cast<const char*>(p + 1) <= limit && readUnit(p))     ++p;
+	return static_cast<size_t>(p - s);
+}
+
+
+RawString linkInfoString(const char* s, const char16_t* sUC, const char* limit) {
+	RawString r;
+	if(sUC) {
+		r.data      = reinterpret_cast<const char*>(sUC);
+		r.length    = boundedLength(sUC, limit);
+		r.isUnicode = true;
+	} else if(s) {
+		r.data   = s;
+		r.length = boundedLength(s, limit);
+	}
+	return r;
+}
+
+
+lnk_status getRaw(const lnk_file* file, lnk_field field, RawString& r) {
+	if(!file)   return LNK_ERR_ARGUMENT;
+	if(field >= LNK_FIELD_NAME && field <= LNK_FIELD_ICON_LOCATION) {
+		const StringRef& s = file->view.string(static_cast<StringItem>(field));
+		if(!s)   return LNK_ERR_MISSING;
+		r.data      = s.data;
+		r.length    = s.length;
+		r.isUnicode = s.isUnicode;
+		return LNK_OK;
+	}
+	if(field == LNK_FIELD_MACHINE_ID || field == LNK_FIELD_ENVIRONMENT_TARGET) {
+		if(file->extraDataBroken)   return LNK_ERR_BROKEN;
+		const bool tracker = (field == LNK_FIELD_MACHINE_ID);
+		const ExtraDataBlock* block = file->extraData.find(tracker ? ExtraDataSignature::TRACKER : ExtraDataSignature::ENVIRONMENT_VARIABLE);
+		if(!block)   return LNK_ERR_MISSING;
+		try {
+			if(tracker) {
+				const TrackerDataBlock t(*block);
+				r.data   = t.machineID;
+				r.length = t.machineIDLength;
+			} else {
+				const EnvironmentVariableDataBlock e(*block);
+				if(e.targetLengthUC) {
+					r.data      = reinterpret_cast<const char*>(e.targetUC);
+					r.length    = e.targetLengthUC;
+					r.isUnicode = true;
+				} else {
+					r.data   = e.target;
+					r.length = e.targetLength;
+				}
+			}
+		}
+		catch(const LNK_error&) {   return LNK_ERR_BROKEN;   }
+		return LNK_OK;
+	}
+	const LinkInfo* li = file->linkInfo.get();
+	if(!li)   return LNK_ERR_MISSING;
+	switch(field) {
+	case LNK_FIELD_LOCAL_BASE_PATH:
+		if(!li->volumeID)   return LNK_ERR_MISSING;
+		r = linkInfoString(li->volumeID->localBasePath, li->volumeID->localBasePathUC, li->afterwards);
+		break;
+	case LNK_FIELD_PATH_SUFFIX:
+		r = linkInfoString(li->commonPathSuffix, li->commonPathSuffixUC, li->afterwards);
+		break;
+	case LNK_FIELD_VOLUME_LABEL:
+		if(!li->volumeID)   return LNK_ERR_MISSING;
+		if(li->volumeID->volumeLabelIsUnicode)   r = linkInfoString(nullptr, li->volumeID->volumeLabelUC, li->afterwards);
+		else                                     r = linkInfoString(li->volumeID->volumeLabel, nullptr, li->afterwards);
+		break;
+	default:
+		return LNK_ERR_ARGUMENT;
+	}
+	return (r.data ? LNK_OK : LNK_ERR_MISSING);
+}
+
+
+/* Writes UTF-8 into a buffer of limited size. Code points that don't fit completely are left out together with
+   everything after them, but still counted, so the writer always knows the size that would have been required. */
+class UTF8Writer {
+	char*  buffer;
+	size_t capacity;    // without the terminating zero
+	size_t written = 0; // bytes actually in the buffer
+	size_t total   = 0; // bytes of the complete string
+public:
+	UTF8Writer(char* buffer, size_t bufferSize) : buffer(bufferSize ? buffer : nullptr), capacity(bufferSize ? bufferSize - 1 : 0) { }
+	void put(uint32_t c) {
+		char b[4];
+		size_t n;
+		if(c < 0x80)          { b[0] = static_cast<char>(c);     n = 1; }
+		else if(c < 0x800)    { b[0] = static_cast<char>(0xC0 | (c >> 6));     b[1] = static_cast<char>(0x80 | (c & 0x3F));     n = 2; }
+		else if(c < 0x10000)  { b[0] = static_cast<char>(0xE0 | (c >> 12));    b[1] = static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+		                        b[2] = static_cast<char>(0x80 | (c & 0x3F));     n = 3; }
+		else                  { b[0] = static_cast<char>(0xF0 | (c >> 18));    b[1] = static_cast<char>(0x80 | ((c >> 12) & 0x3F));
+		                        b[2] = static_cast<char>(0x80 | ((c >> 6) & 0x3F));     b[3] = static_cast<char>(0x80 | (c & 0x3F));     n = 4; }
+		if(written == total && written + n <= capacity) {
+			for(size_t i = 0;     i < n;     ++i)   buffer[written + i] = b[i];
+			written += n;
+		}
+		total += n;
+	}
+	void put(const RawString& s) {
+		if(!s.isUnicode) {
+			for(size_t i = 0;     i < s.length;     ++i)     put(cp1252ToUnicode(static_cast<unsigned char>(s.data[i])));
+			return;
+		}
+		const char16_t* p = reinterpret_cast<const char16_t*>(s.data), * e = p + s.length;
+		if(written == total && capacity - written >= utf8MaxLength(s.length)) { // surely fits, so convert in one go
+			const size_t n = utf16ToUTF8(p, s.length, buffer + written);
+			written += n;
+			total   += n;
+			return;
+		}
+		while(p < e) {
+			uint32_t c = *p++;
+			if(c >= 0xD800 && c < 0xDC00 && p < e && *p >= 0xDC00 && *p < 0xE000)
+				c = 0x10000 + ((c - 0xD800) << 10) + (*p++ - 0xDC00);
+			else if(c >= 0xD800 && c < 0xE000)   c = 0xFFFD; // unpaired surrogate
+			put(c);
+		}
+	}
+	size_t finish() { // terminates the buffer, returns the required buffer size
+		if(buffer)   buffer[written] = '\0';
+		return total + 1;
+	}
+};
+
+} // namespace
+
+
+
+lnk_status lnk_parse(const void* data, size_t size, lnk_file** file) {
+	if(!file || (!data && size))   return LNK_ERR_ARGUMENT;
+	*file = nullptr;
+	const char* begin = static_cast<const char*>(data);
+	try {
+		*file = new lnk_file(begin, begin + size);
+		return LNK_OK;
+	}
+	catch(const LNK_error& e) {   return (e.cause == LNK_error::WRONG_HEADER ? LNK_ERR_HEADER : LNK_ERR_BROKEN);   }
+	catch(const std::bad_alloc&) {   return LNK_ERR_MEMORY;   }
+	catch(...) {   return LNK_ERR_BROKEN;   }
+}
+
+
+void lnk_free(lnk_file* file) {
+	delete file;
+}
+
+
+uint32_t lnk_flags(const lnk_file* file) {
+	return (file ? file->view.flags : 0);
+}
+
+
+int32_t lnk_icon_index(const lnk_file* file) {
+	return (file ? static_cast<int32_t>(file->view.iconIdx) : 0);
+}
+
+
+lnk_status lnk_volume(const lnk_file* file, int* driveType, uint32_t* serialNumber) {
+	if(!file)   return LNK_ERR_ARGUMENT;
+	if(!file->linkInfo || !file->linkInfo->volumeID)   return LNK_ERR_MISSING;
+	if(driveType)      *driveType    = file->linkInfo->volumeID->driveType;
+	if(serialNumber)   *serialNumber = file->linkInfo->volumeID->serialNumber;
+	return LNK_OK;
+}
+
+
+lnk_status lnk_field_raw(const lnk_file* file, lnk_field field, const void** data, size_t* length, lnk_encoding* encoding) {
+	RawString r;
+	lnk_status st = getRaw(file, field, r);
+	if(st != LNK_OK)   return st;
+	if(data)       *data     = r.data;
+	if(length)     *length   = r.length;
+	if(encoding)   *encoding = (r.isUnicode ? LNK_ENC_UTF16LE : LNK_ENC_ANSI);
+	return LNK_OK;
+}
+
+
+lnk_status lnk_field_utf8(const lnk_file* file, lnk_field field, char* buffer, size_t bufferSize, size_t* required) {
+	if(!buffer && bufferSize)   return LNK_ERR_ARGUMENT;
+	UTF8Writer w(buffer, bufferSize);
+	if(field == LNK_FIELD_KNOWN_FOLDER_ID) {
+		if(!file)   return LNK_ERR_ARGUMENT;
+		if(file->extraDataBroken)   return LNK_ERR_BROKEN;
+		const ExtraDataBlock* block = file->extraData.find(ExtraDataSignature::KNOWN_FOLDER);
+		if(!block)   return LNK_ERR_MISSING;
+		std::string id;
+		try {
+			id = KnownFolderDataBlock(*block).knownFolderID.toString();
+		}
+		catch(const LNK_error&) {   return LNK_ERR_BROKEN;   }
+		for(char c : id)   w.put(static_cast<uint32_t>(c));
+	} else if(field == LNK_FIELD_TARGET_PATH && file && !file->linkInfo) { // the path reconstructed from the shell items
+		if(!file->view.linkTargetIDList)   return LNK_ERR_MISSING;
+		std::u16string path;
+		try {
+			path = LinkTargetIDList(file->view.linkTargetIDList, file->end).path();
+		}
+		catch(const LNK_error&) {   return LNK_ERR_BROKEN;   }
+		if(path.empty())   return LNK_ERR_MISSING;
+		RawString r;
+		r.data      = reinterpret_cast<const char*>(path.data());
+		r.length    = path.size();
+		r.isUnicode = true;
+		w.put(r);
+	} else if(field == LNK_FIELD_TARGET_PATH) {
+		RawString base, suffix;
+		lnk_status st = getRaw(file, LNK_FIELD_LOCAL_BASE_PATH, base);
+		if(st != LNK_OK && st != LNK_ERR_MISSING)   return st;
+		if((st = getRaw(file, LNK_FIELD_PATH_SUFFIX, suffix)) != LNK_OK)   return st;
+		w.put(base);
+		w.put(suffix);
+	} else {
+		RawString r;
+		lnk_status st = getRaw(file, field, r);
+		if(st != LNK_OK)   return st;
+		w.put(r);
+	}
+	size_t n = w.finish();
+	if(required)   *required = n;
+	return LNK_OK;
+}
@@ -0,0 +1,76 @@
+#ifndef LNKPARSE_C_H
+#define LNKPARSE_C_H
+/* C interface of the lnkparse library, for embedding the link file parser in other programs.
+   Only plain C types cross this interface, so it stays binary compatible between versions. */
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(_WIN32) && defined(LNKPARSE_SHARED_BUILD)
+#	define LNKPARSE_API __declspec(dllexport)
+#elif defined(_WIN32) && defined(LNKPARSE_SHARED)
+#	define LNKPARSE_API __declspec(dllimport)
+#elif defined(__GNUC__)
+#	define LNKPARSE_API __attribute__((visibility("default")))
+#else
+#	define LNKPARSE_API
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct lnk_file lnk_file;
+
+typedef enum lnk_status {
+	LNK_OK           = 0,
+	LNK_ERR_BROKEN   = 1, /* the file is truncated or its content inconsistent */
+	LNK_ERR_HEADER   = 2, /* not a link file */
+	LNK_ERR_MISSING  = 3, /* the requested field isn't contained in the link file */
+	LNK_ERR_ARGUMENT = 4,
+	LNK_ERR_MEMORY   = 5
+} lnk_status;
+
+typedef enum lnk_field {
+	LNK_FIELD_NAME             = 0, /* StringData */
+	LNK_FIELD_RELATIVE_PATH    = 1,
+	LNK_FIELD_WORKING_DIR      = 2,
+	LNK_FIELD_ARGUMENTS        = 3,
+	LNK_FIELD_ICON_LOCATION    = 4,
+	LNK_FIELD_LOCAL_BASE_PATH  = 5, /* LinkInfo */
+	LNK_FIELD_PATH_SUFFIX      = 6,
+	LNK_FIELD_VOLUME_LABEL     = 7,
+	LNK_FIELD_TARGET_PATH      = 8, /* local base path + path suffix, as getLNKinfo /PF returns it; without LinkInfo the
+	                                   path reconstructed from the LinkTargetIDList */
+	LNK_FIELD_MACHINE_ID       = 9, /* ExtraData: TrackerDataBlock */
+	LNK_FIELD_ENVIRONMENT_TARGET = 10, /* EnvironmentVariableDataBlock */
+	LNK_FIELD_KNOWN_FOLDER_ID  = 11  /* KnownFolderDataBlock, as {GUID} */
+} lnk_field;
+
+typedef enum lnk_encoding {
+	LNK_ENC_ANSI     = 0, /* single byte, in the system codepage of the machine that created the link */
+	LNK_ENC_UTF16LE  = 1
+} lnk_encoding;
+
+/* Parses the content of a link file. No copy is made: data must stay valid until lnk_free is called. */
+LNKPARSE_API lnk_status lnk_parse(const void* data, size_t size, lnk_file** file);
+LNKPARSE_API void       lnk_free(lnk_file* file);
+
+LNKPARSE_API uint32_t   lnk_flags(const lnk_file* file);      /* LinkFlags, see MS-SHLLNK 2.1.1 */
+LNKPARSE_API int32_t    lnk_icon_index(const lnk_file* file);
+LNKPARSE_API lnk_status lnk_volume(const lnk_file* file, int* driveType, uint32_t* serialNumber);
+
+/* The field as stored in the file: *data points into the buffer given to lnk_parse, *length is in code units
+   and there is no terminating zero. Not available for LNK_FIELD_TARGET_PATH and LNK_FIELD_KNOWN_FOLDER_ID,
+   which aren't stored as strings. */
+LNKPARSE_API lnk_status lnk_field_raw(const lnk_file* file, lnk_field field, const void** data, size_t* length, lnk_encoding* encoding);
+
+/* The field converted to UTF-8 (ANSI strings are taken as Windows-1252) and zero terminated. Writes at most
+   bufferSize bytes and sets *required to the size needed including the terminating zero, so a call with
+   bufferSize 0 measures the field. A buffer that is too small gets a truncated string, the result is still LNK_OK. */
+LNKPARSE_API lnk_status lnk_field_utf8(const lnk_file* file, lnk_field field, char* buffer, size_t bufferSize, size_t* required);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,45 @@
+#include "parseContext.h"
+#include <algorithm>
+#include <cstdint>
+
+
+void* ParseContext::allocate(size_t n, size_t alignment) {
+	for(;;) {
+		if(current < blocks.size()) {
+			Block& b = blocks[current];
+			const uintptr_t base = reinterpret_cast<uintptr_t>(b.memory.get());
+			const size_t at = static_cast<size_t>(((base + used + alignment - 1) & ~(uintptr_t(alignment) - 1)) - base);
+			if(at + n <= b.size) {
+				used = at + n;
+				return b.memory.get() + at;
+			}
+			if(current + 1 < blocks.size() && blocks[current + 1].size >= n + alignment) { // the blocks of an earlier parse
+				++current;
+				used = 0;
+				continue;
+			}
+		}
+		const size_t size = std::max(blockSize, n + alignment);
+		blocks.push_back(Block{ std::unique_ptr<char[]>(new char[size]), size });
+		current = blocks.size() - 1;
+		used = 0;
+	}
+}
+
+
+void ParseContext::reset() {
+	if(blocks.size() > 1) {
+		const size_t total = capacity();
+		blocks.clear();
+		blocks.push_back(Block{ std::unique_ptr<char[]>(new char[total]), total });
+	}
+	current = 0;
+	used = 0;
+}
+
+
+size_t ParseContext::capacity() const {
+	size_t n = 0;
+	for(const Block& b : blocks)     n += b.size;
+	return n;
+}
@@ -0,0 +1,56 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+
+/* Memory for parsing many link files one after the other. The objects of a parse are bump allocated from the context,
+   and reset() makes all of its memory available again for the next file instead of freeing it. After the first few
+   files a context has grown to what a file needs, and from then on parsing with it doesn't allocate.
+   A context is meant to be used by one thread; give every worker thread its own. */
+class ParseContext {
+	struct Block {
+		std::unique_ptr<char[]> memory;
+		size_t size;
+	};
+	std::vector<Block> blocks;
+	size_t current = 0; // the block being allocated from
+	size_t used    = 0; // in that block
+	size_t blockSize;
+public:
+	explicit ParseContext(size_t blockSize = 16 * 1024) : blockSize(blockSize) { }
+	ParseContext(const ParseContext&) = delete;
+	ParseContext& operator=(const ParseContext&) = delete;
+
+	void* allocate(size_t n, size_t alignment = alignof(std::max_align_t));
+	template<typename T> T* allocateArray(size_t n) { return static_cast<T*>(allocate(n * sizeof(T), alignof(T))); }
+	template<typename T, typename... Args> T* make(Args&&... args) { return new(allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...); }
+	/* Everything allocated from the context is given up; the objects must have been destroyed already.
+	   If the last parse needed more than one block, they are merged into one big enough for all of it. */
+	void reset();
+	size_t capacity() const;
+};
+
+
+/* Deletes an object made with new, or only destroys it if it lives in a ParseContext. Converts from std::default_delete,
+   so a std::unique_ptr can be assigned to a ParsePtr. */
+struct ParseDeleter {
+	bool inContext = false;
+	ParseDeleter() = default;
+	explicit ParseDeleter(bool inContext) : inContext(inContext) { }
+	template<typename T> ParseDeleter(const std::default_delete<T>&) { }
+	template<typename T> void operator()(T* p) const {
+		if(inContext)   p->~T();
+		else            delete p;
+	}
+};
+
+template<typename T> using ParsePtr = std::unique_ptr<T, ParseDeleter>;
+
+// Makes the object in the context, or on the heap if there is none
+template<typename T, typename... Args> ParsePtr<T> makeParsed(ParseContext* context, Args&&... args) {
+	if(!context)   return ParsePtr<T>(new T(std::forward<Args>(args)...));
+	return ParsePtr<T>(context->make<T>(std::forward<Args>(args)...), ParseDeleter(true));
+}
@@ -0,0 +1,185 @@
+#include "recordWriter.h"
+#include "utf8.h"
+#include "stats.h"
+
+
+RecordWriter::RecordWriter(RecordFormat format, const Output& out, size_t flushSize) :
+	format(format), out(out), flushSize(flushSize)
+{
+	buffer.reserve(flushSize + 4096);
+}
+
+
+void RecordWriter::header(const char* const* names, size_t n) {
+	if(format == RecordFormat::JSON)   return;
+	beginRecord();
+	for(size_t i = 0;     i < n;     ++i)     asciiField(nullptr, names[i]);
+	endRecord();
+}
+
+
+void RecordWriter::beginRecord() {
+	recordStart = buffer.size();
+	firstField = true;
+	if(format == RecordFormat::JSON)   buffer += '{';
+}
+
+
+void RecordWriter::endRecord() {
+	buffer += (format == RecordFormat::JSON ? "}\n" : "\r\n");
+	if(buffer.size() >= flushSize)   flush();
+}
+
+
+void RecordWriter::abandonRecord() {
+	buffer.resize(recordStart);
+}
+
+
+void RecordWriter::name(const char* name) {
+	if(format == RecordFormat::JSON) {
+		if(!firstField)   buffer += ',';
+		((buffer += '"') += name) += "\":";
+	} else if(!firstField)   buffer += (format == RecordFormat::CSV ? ',' : '\t');
+	firstField = false;
+}
+
+
+namespace {
+	bool needsEscaping(RecordFormat format, char c) {
+		switch(format) {
+		case RecordFormat::JSON:   return c == '"' || c == '\\' || static_cast<unsigned char>(c) < 0x20;
+		case RecordFormat::CSV:    return c == '"' || c == ','  || c == '\r' || c == '\n';
+		default:                   return c == '\t' || c == '\\' || c == '\r' || c == '\n';
+		}
+	}
+}
+
+
+void RecordWriter::escaped(const char* s, size_t n) {
+	const char* const end = s + n;
+	const char* p = s;
+	while(p != end && !needsEscaping(format, *p))     ++p;
+	const bool quoted = (format == RecordFormat::JSON || (format == RecordFormat::CSV && p != end)); // CSV only if necessary
+	if(quoted)   buffer += '"';
+	// the characters that need escaping are all ASCII, so the UTF-8 sequences can be copied in runs
+	for(;;) {
+		buffer.append(s, p);
+		if(p == end)   break;
+		const char c = *p;
+		if(format == RecordFormat::CSV)   (c == '"' ? buffer += "\"\"" : buffer += c); // inside the quotes only '"' is special
+		else switch(c) {
+		case '\\':   buffer += "\\\\";     break;
+		case '"':    buffer += "\\\"";     break;
+		case '\t':   buffer += "\\t";      break;
+		case '\r':   buffer += "\\r";      break;
+		case '\n':   buffer += "\\n";      break;
+		default: { // other control characters, JSON only
+			char esc[8];
+			sprintf_s<8>(esc, "\\u%04x", static_cast<unsigned int>(static_cast<unsigned char>(c)));
+			buffer += esc;
+		}
+		}
+		s = ++p;
+		while(p != end && !needsEscaping(format, *p))     ++p;
+	}
+	if(quoted)   buffer += '"';
+}
+
+
+template<typename Convert> void RecordWriter::converted(size_t maxLength, Convert convert) {
+	StageSpan encoding(Stage::ENCODE);
+	// usually there's nothing to escape, so the string is converted right into the buffer, and only moved if necessary
+	const bool   json  = (format == RecordFormat::JSON);
+	const size_t start = buffer.size();
+	if(json)   buffer += '"';
+	const size_t begin = buffer.size();
+	buffer.resize(begin + maxLength);
+	const size_t len = convert(&buffer[begin]);
+	buffer.resize(begin + len);
+	const char* p = buffer.data() + begin;
+	while(p != buffer.data() + buffer.size() && !needsEscaping(format, *p))     ++p;
+	if(p == buffer.data() + buffer.size()) {
+		if(json)   buffer += '"';
+		return;
+	}
+	utf8.assign(buffer, begin, len);
+	buffer.resize(start);
+	escaped(utf8.data(), len);
+}
+
+
+void RecordWriter::field(const char* name, const wchar_t* s, size_t n) {
+	this->name(name);
+	converted(utf8MaxLength(n), [&](char* dst) { return utf16ToUTF8(reinterpret_cast<const char16_t*>(s), n, dst); });
+}
+
+
+void RecordWriter::field(const char* name, const char* s, size_t n, UINT codepage) {
+	const char* p = s;
+	while(p != s + n && static_cast<unsigned char>(*p) < 0x80)     ++p;
+	if(p == s + n) { // ASCII is the same in every codepage
+		this->name(name);
+		escaped(s, n);
+		return;
+	}
+	if(codepage == CP_ACP) {
+		this->name(name);
+		converted(utf8MaxLength(n), [&](char* dst) { return ansiToUTF8(s, n, dst); });
+		return;
+	}
+	if(utf16.size() < n)   utf16.resize(n);
+	StageSpan decoding(Stage::ENCODE);
+	const int len = MultiByteToWideChar(codepage, 0, s, static_cast<int>(n), &utf16[0], static_cast<int>(utf16.size()));
+	decoding.end();
+	field(name, utf16.data(), len);
+}
+
+
+void RecordWriter::field(const char* name, uint32_t value) {
+	this->name(name);
+	char buf[16];
+	sprintf_s<16>(buf, "%u", value);
+	buffer += buf;
+}
+
+
+void RecordWriter::asciiField(const char* name, const char* s) {
+	this->name(name);
+	escaped(s, std::strlen(s));
+}
+
+
+void RecordWriter::flagsField(const char* name, uint32_t flags) {
+	this->name(name);
+	const bool json = (format == RecordFormat::JSON);
+	if(json)   buffer += '[';
+	bool first = true;
+	for(const FlagName& f : flagNames) {
+		if(!(flags & f.flag))   continue;
+		if(!first)   buffer += (json ? "," : "|");
+		if(json)   ((buffer += '"') += f.name) += '"';
+		else       buffer += f.name;
+		first = false;
+	}
+	if(json)   buffer += ']';
+}
+
+
+void RecordWriter::null(const char* name) {
+	this->name(name);
+	if(format == RecordFormat::JSON)   buffer += "null";
+}
+
+
+void RecordWriter::append(const char* s, size_t n) {
+	buffer.append(s, n);
+	if(buffer.size() >= flushSize)   flush();
+}
+
+
+void RecordWriter::flush() {
+	if(buffer.empty())   return;
+	out.write(buffer.data(), buffer.size());
+	buffer.clear();
+}
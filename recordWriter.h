@@ -0,0 +1,53 @@
+#pragma once
+#include "getLNKinfo.h"
+#include <string>
+
+
+enum struct RecordFormat {
+	JSON, // JSON Lines: one object per line
+	CSV,  // RFC 4180, with a header line
+	TSV   // with a header line; TAB, CR, LF and backslash in values are escaped with a backslash
+};
+
+
+/* Writes one record per link file in a machine readable format, always encoded as UTF-8.
+   The records are collected in one big buffer that is reused throughout the run and written out only when it is full,
+   so bulk output takes a few large writes instead of one per printed fragment.
+   With CSV and TSV the fields are identified by their position, so every record must have the same fields. */
+class RecordWriter {
+	RecordFormat format;
+	Output       out;
+	size_t       flushSize;
+	std::string  buffer;
+	size_t       recordStart = 0;
+	bool         firstField  = true;
+	std::string  utf8;  // scratch buffers for converting fields, reused to avoid allocations
+	std::wstring utf16;
+
+	void name(const char* name);
+	void escaped(const char* s, size_t n); // s is UTF-8
+	template<typename Convert> void converted(size_t maxLength, Convert convert); // the value, converted to UTF-8 by convert(dst)
+public:
+	static constexpr size_t defaultFlushSize = 1 << 20;
+
+	RecordWriter(RecordFormat format, const Output& out, size_t flushSize = defaultFlushSize);
+	RecordWriter(const RecordWriter&) = delete;
+	RecordWriter& operator=(const RecordWriter&) = delete;
+	~RecordWriter() { flush(); }
+
+	void header(const char* const* names, size_t n); // the column names; ignored for JSON
+	void beginRecord();
+	void endRecord();   // the record may be written out now
+	void abandonRecord(); // removes the fields since beginRecord
+
+	void field(const char* name, const wchar_t* s, size_t n);
+	void field(const char* name, const char* s, size_t n, UINT codepage); // 8 bit string in the given codepage
+	void field(const char* name, uint32_t value);
+	void asciiField(const char* name, const char* s);
+	void flagsField(const char* name, uint32_t flags); // names of the set flags; JSON array or separated by '|'
+	void null(const char* name); // a missing field
+
+	void append(const char* s, size_t n); // complete records formatted by another RecordWriter
+	void flush();
+	void redirect(const Output& target) { flush();     out = target; }
+};
@@ -0,0 +1,33 @@
+/* Resident link file query server, see queryServer.h for the protocol.
+   Usage: lnkserver [-t threads] endpoint
+   endpoint is the name of the pipe (\\.\pipe\endpoint) on Windows and the path of the Unix domain socket elsewhere. */
+#include "queryServer.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+
+namespace {
+	int usage() {
+		std::fprintf(stderr, "Usage: lnkserver [-t threads] endpoint\n");
+		return EXIT_FAILURE;
+	}
+}
+
+
+int main(int argc, char* argv[]) {
+	QueryServerOptions options;
+	const char* endpoint = nullptr;
+	for(int i = 1;     i < argc;     ++i)
+		if(std::strcmp(argv[i], "-t") == 0 && i + 1 < argc)   options.nThreads = static_cast<unsigned int>(std::strtoul(argv[++i], nullptr, 10));
+		else if(endpoint || argv[i][0] == '-')                 return usage();
+		else                                                   endpoint = argv[i];
+	if(!endpoint)   return usage();
+	for(const char* p = endpoint;     *p;     ++p)     options.endpoint += static_cast<PathChar>(static_cast<unsigned char>(*p));
+	std::string error;
+	if(!runQueryServer(options, error)) {
+		std::fprintf(stderr, "lnkserver: %s\n", error.c_str());
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,400 @@
+#include "queryServer.h"
+#include "lnkparse.h"
+#include "utf8.h"
+#include "unaligned.h"
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <cerrno>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#endif
+
+
+namespace {
+
+enum struct Info { F, P, PF, PR, VL, VT, W, CL, I, N, MID, ENV, KF };
+constexpr const char* infoNames[]{ "F", "P", "PF", "PR", "VL", "VT", "W", "CL", "I", "N", "MID", "ENV", "KF" };
+constexpr int    nInfoNames    = static_cast<int>(sizeof(infoNames) / sizeof(*infoNames));
+constexpr int    maxInfos      = 32;
+constexpr size_t maxLineLength = 64 * 1024;
+constexpr size_t receiveSize   = 16 * 1024;
+constexpr size_t initialPrefix = 4096; // like getLNKinfo.exe, only the beginning of a link file is read at first
+
+
+/* Everything a worker needs, allocated once and reused for all connections and requests,
+   so after the first few requests answering one doesn't allocate */
+struct Worker {
+	FileContent content;
+	ParseContext context; // for the decoded sections, reset for every request
+	PathString  path;
+	std::string input;   // received data that hasn't been answered yet
+	std::string reply;   // the replies to everything that was received in one go
+	std::string scratch;
+	char        received[receiveSize];
+};
+
+
+bool parseInfos(const char* p, const char* end, Info* infos, int& n) {
+	n = 0;
+	while(p < end) {
+		while(p < end && *p == ' ')     ++p;
+		const char* b = p;
+		while(p < end && *p != ' ')     ++p;
+		if(b == p)   break;
+		if(*b == '/' || *b == '-')   ++b;
+		int i = 0;
+		for(;     i < nInfoNames;     ++i) {
+			const char* name = infoNames[i];
+			const char* q = b;
+			while(q < p && *name && (*q & ~0x20) == *name)     { ++q;     ++name; } // ASCII case insensitive
+			if(q == p && !*name)   break;
+		}
+		if(i == nInfoNames || n == maxInfos)   return false;
+		infos[n++] = static_cast<Info>(i);
+	}
+	if(n == 0)   infos[n++] = Info::PF;
+	return true;
+}
+
+
+uint32_t partsFor(Info info) {
+	switch(info) {
+	case Info::W:     return stringPart(StringItem::WORKINGDIR);
+	case Info::I:     return stringPart(StringItem::ICONLOC);
+	case Info::PR:    return stringPart(StringItem::RELPATH);
+	case Info::N:     return stringPart(StringItem::NAMESTRING);
+	case Info::CL:    return stringPart(StringItem::COMMANDLINE);
+	case Info::MID:
+	case Info::ENV:
+	case Info::KF:    return PART_EXTRADATA;
+	case Info::F:
+	case Info::P:
+	case Info::PF:    return PART_LINKTARGETIDLIST|PART_LINKINFO; // the shell items are the fallback
+	default:          return PART_LINKINFO;
+	}
+}
+
+
+void appendUTF16(std::string& s, const char16_t* p, size_t n) {
+	const size_t at = s.size();
+	s.resize(at + utf8MaxLength(n));
+	s.resize(at + utf16ToUTF8(p, n, &s[at]));
+}
+
+void appendANSI(std::string& s, const char* p, size_t n) {
+	const size_t at = s.size();
+	s.resize(at + utf8MaxLength(n));
+	s.resize(at + cp1252ToUTF8(p, n, &s[at]));
+}
+
+void appendString(std::string& s, const StringRef& r) {
+	if(r.isUnicode)   appendUTF16(s, r.dataUC(), r.length);
+	else              appendANSI(s, r.data, r.length);
+}
+
+// Terminated strings of the LinkInfo must end before limit
+void appendTerminated(std::string& s, const char* p, const char* limit) {
+	const char* e = p;
+	while(e < limit && *e)     ++e;
+	appendANSI(s, p, static_cast<size_t>(e - p));
+}
+
+void appendTerminated(std::string& s, const char16_t* p, const char* limit) {
+	const char16_t* e = p;
+	while(reinterpret_cast<const char*>(e + 1) <= limit && readUnit(e))     ++e;
+	appendUTF16(s, p, static_cast<size_t>(e - p));
+}
+
+
+// Escapes the value that starts at from; there's rarely anything to escape, so it's only copied if there is
+void escapeValue(std::string& reply, size_t from, std::string& scratch) {
+	auto special = [](char c) { return c == '\t' || c == '\r' || c == '\n' || c == '\\'; };
+	if(std::none_of(reply.begin() + from, reply.end(), special))   return;
+	scratch.assign(reply, from, std::string::npos);
+	reply.resize(from);
+	for(char c : scratch)
+		if(!special(c))   reply += c;
+		else              (reply += '\\') += (c == '\t' ? 't' : c == '\r' ? 'r' : c == '\n' ? 'n' : '\\');
+}
+
+
+// The target path starts at from; for F and P only its file name or directory is kept
+void cutTarget(std::string& reply, size_t from, Info info) {
+	if(info == Info::PF)   return;
+	size_t sep = reply.size(); // the separators are ASCII, so the UTF-8 can be cut there
+	while(sep > from && reply[sep - 1] != '\\' && reply[sep - 1] != '/')     --sep;
+	if(info == Info::F)      reply.erase(from, sep - from);
+	else                     reply.resize(sep > from ? sep - 1 : from); // without trailing slash
+}
+
+
+void answerInfos(Worker& w, const char* pathBegin, const char* pathEnd, const Info* infos, int n) {
+#ifdef _WIN32
+	const int len = static_cast<int>(pathEnd - pathBegin);
+	w.path.resize(len);
+	w.path.resize(len ? MultiByteToWideChar(CP_UTF8, 0, pathBegin, len, &w.path[0], len) : 0);
+#else
+	w.path.assign(pathBegin, pathEnd);
+#endif
+	uint32_t parts = 0;
+	for(int i = 0;     i < n;     ++i)     parts |= partsFor(infos[i]);
+	w.content.load(w.path.c_str(), initialPrefix);
+	LNKView lnk(w.content.begin(), w.content.end(), parts, w.content.fileSize());
+	while(lnk.prefixNeeded) {
+		w.content.extend(std::max(lnk.prefixNeeded, 2 * w.content.size()));
+		lnk = LNKView(w.content.begin(), w.content.end(), parts, w.content.fileSize());
+	}
+	w.context.reset();
+	ParsePtr<LinkInfo> linkInfo;
+	ExtraDataIndex extraData;
+	bool extraDataIndexed = false;
+	std::string& reply = w.reply;
+	reply += "OK";
+	for(int i = 0;     i < n;     ++i) {
+		reply += '\t';
+		const size_t from = reply.size();
+		const Info info = infos[i];
+		switch(info) {
+		case Info::F:
+		case Info::P:
+		case Info::PF:
+		case Info::VL:
+		case Info::VT: {
+			if(!lnk.linkInfo && info != Info::VL && info != Info::VT && lnk.linkTargetIDList) { // the path from the shell items
+				const std::u16string path = LinkTargetIDList(lnk.linkTargetIDList, w.content.end(), &w.context).path();
+				appendUTF16(reply, path.data(), path.size());
+				cutTarget(reply, from, info);
+				break;
+			}
+			if(!lnk.linkInfo)   break;
+			if(!linkInfo)   linkInfo = makeParsed<LinkInfo>(&w.context, lnk.linkInfo, w.content.end(), &w.context);
+			const VolumeIDandBasePath* volumeID = linkInfo->volumeID.get();
+			if(info == Info::VL || info == Info::VT) {
+				if(!volumeID)               break;
+				if(info == Info::VT)        reply += driveTypeNames[volumeID->driveType];
+				else if(volumeID->volumeLabelIsUnicode)   appendTerminated(reply, volumeID->volumeLabelUC, linkInfo->afterwards);
+				else                                      appendTerminated(reply, volumeID->volumeLabel, linkInfo->afterwards);
+				break;
+			}
+			if(volumeID) {
+				if(volumeID->localBasePathUC)   appendTerminated(reply, volumeID->localBasePathUC, linkInfo->afterwards);
+				else                            appendTerminated(reply, volumeID->localBasePath, linkInfo->afterwards);
+			}
+			if(linkInfo->commonPathSuffixUC)   appendTerminated(reply, linkInfo->commonPathSuffixUC, linkInfo->afterwards);
+			else                               appendTerminated(reply, linkInfo->commonPathSuffix, linkInfo->afterwards);
+			cutTarget(reply, from, info);
+			break;
+		}
+		case Info::PR:   appendString(reply, lnk.string(StringItem::RELPATH));       break;
+		case Info::W:    appendString(reply, lnk.string(StringItem::WORKINGDIR));    break;
+		case Info::CL:   appendString(reply, lnk.string(StringItem::COMMANDLINE));   break;
+		case Info::N:    appendString(reply, lnk.string(StringItem::NAMESTRING));    break;
+		case Info::I:
+			if(!lnk.string(StringItem::ICONLOC))   break;
+			appendString(reply, lnk.string(StringItem::ICONLOC));
+			(reply += ',') += std::to_string(lnk.iconIdx);
+			break;
+		case Info::MID:
+		case Info::ENV:
+		case Info::KF: {
+			if(!extraDataIndexed)   extraData = ExtraDataIndex(lnk.afterwards, w.content.end());
+			extraDataIndexed = true;
+			const ExtraDataBlock* block = extraData.find(info == Info::MID ? ExtraDataSignature::TRACKER :
+			                                             info == Info::ENV ? ExtraDataSignature::ENVIRONMENT_VARIABLE : ExtraDataSignature::KNOWN_FOLDER);
+			if(!block)   break;
+			if(info == Info::MID) {
+				const TrackerDataBlock tracker(*block);
+				appendANSI(reply, tracker.machineID, tracker.machineIDLength);
+			} else if(info == Info::ENV) {
+				const EnvironmentVariableDataBlock env(*block);
+				if(env.targetLengthUC)   appendUTF16(reply, env.targetUC, env.targetLengthUC);
+				else                     appendANSI(reply, env.target, env.targetLength);
+			} else reply += KnownFolderDataBlock(*block).knownFolderID.toString();
+			break;
+		}
+		}
+		escapeValue(reply, from, w.scratch);
+	}
+}
+
+
+void answer(Worker& w, const char* line, size_t length) {
+	const size_t start = w.reply.size();
+	const char* end = line + length;
+	const char* tab = std::find(line, end, '\t');
+	Info infos[maxInfos];
+	int n;
+	const char* error = nullptr;
+	if(tab == end || !parseInfos(line, tab, infos, n))   error = "bad request";
+	else try {
+		answerInfos(w, tab + 1, end, infos, n);
+	}
+	catch(const LNK_error& e) {   error = (e.cause == LNK_error::WRONG_HEADER ? "wrong file header, not a proper .lnk file" : "link file is broken");   }
+	catch(const FileError& e) {   error = (e.cause == FileError::OPEN ? "link file doesn't exist or could not be opened" : "link file could not be read");   }
+	catch(const std::exception&) {   error = "link file is broken";   }
+	if(error)   (w.reply.erase(start) += "ERR\t") += error;
+	w.reply += '\n';
+}
+
+
+/* Answers the requests of one connection until it's closed. All requests that arrive together are answered with one write. */
+template<typename Receive, typename Send> void serve(Worker& w, Receive&& receive, Send&& send) {
+	w.input.clear();
+	for(;;) {
+		const long n = receive(w.received, receiveSize);
+		if(n <= 0)   return;
+		w.input.append(w.received, static_cast<size_t>(n));
+		w.reply.clear();
+		size_t pos = 0;
+		for(size_t lf;     (lf = w.input.find('\n', pos)) != std::string::npos;     pos = lf + 1) {
+			size_t length = lf - pos;
+			if(length > 0 && w.input[pos + length - 1] == '\r')   --length;
+			answer(w, w.input.data() + pos, length);
+		}
+		w.input.erase(0, pos);
+		const bool tooLong = (w.input.size() > maxLineLength);
+		if(tooLong)   w.reply += "ERR\trequest too long\n";
+		if(!w.reply.empty() && !send(w.reply.data(), w.reply.size()))   return;
+		if(tooLong)   return;
+	}
+}
+
+} // namespace
+
+
+#ifdef _WIN32
+
+namespace {
+	HANDLE createPipe(const PathString& name, bool first) {
+		return CreateNamedPipe(name.c_str(), PIPE_ACCESS_DUPLEX | (first ? FILE_FLAG_FIRST_PIPE_INSTANCE : 0),
+		                       PIPE_TYPE_BYTE|PIPE_READMODE_BYTE|PIPE_WAIT|PIPE_REJECT_REMOTE_CLIENTS, PIPE_UNLIMITED_INSTANCES,
+		                       64 * 1024, 64 * 1024, 0, NULL);
+	}
+
+	// Every worker has its own pipe instance, which it connects to one client after the other
+	void pipeWorker(HANDLE hPipe) {
+		auto w = std::make_unique<Worker>();
+		for(;;) {
+			if(ConnectNamedPipe(hPipe, NULL) || GetLastError() == ERROR_PIPE_CONNECTED) {
+				serve(*w, [hPipe](char* buf, size_t size) {
+					DWORD n = 0;
+					return ReadFile(hPipe, buf, static_cast<DWORD>(size), &n, NULL) ? static_cast<long>(n) : -1L;
+				}, [hPipe](const char* buf, size_t size) {
+					DWORD n = 0;
+					for(size_t done = 0;     done < size;     done += n)
+						if(!WriteFile(hPipe, buf + done, static_cast<DWORD>(size - done), &n, NULL))   return false;
+					return true;
+				});
+			}
+			DisconnectNamedPipe(hPipe);
+		}
+	}
+}
+
+
+bool runQueryServer(const QueryServerOptions& options, std::string& error) {
+	const PathString name = PathString(L"\\\\.\\pipe\\") + options.endpoint;
+	const unsigned int nThreads = (options.nThreads ? options.nThreads : std::max(1u, std::thread::hardware_concurrency()));
+	std::vector<HANDLE> pipes;
+	for(unsigned int i = 0;     i < nThreads;     ++i) { // all instances are created up front, so errors show up right away
+		HANDLE hPipe = createPipe(name, i == 0);
+		if(hPipe == INVALID_HANDLE_VALUE) {
+			error = (i == 0 && GetLastError() == ERROR_ACCESS_DENIED ? "the pipe is already in use" : "the pipe could not be created");
+			for(HANDLE h : pipes)     CloseHandle(h);
+			return false;
+		}
+		pipes.push_back(hPipe);
+	}
+	std::vector<std::thread> threads;
+	for(HANDLE hPipe : pipes)     threads.emplace_back(pipeWorker, hPipe);
+	for(std::thread& t : threads)     t.join();
+	return true;
+}
+
+#else
+
+namespace {
+	// A socket file that nobody listens on anymore is left over from an earlier run; anything else at the path is someone's
+	bool isStaleSocket(const sockaddr_un& addr) {
+		struct stat st;
+		if(lstat(addr.sun_path, &st) != 0 || !S_ISSOCK(st.st_mode))   return false;
+		const int probe = socket(AF_UNIX, SOCK_STREAM|SOCK_CLOEXEC, 0);
+		if(probe < 0)   return false;
+		const bool refused = (connect(probe, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) != 0 && errno == ECONNREFUSED);
+		close(probe);
+		return refused;
+	}
+
+	// The workers all accept connections on the same socket
+	void socketWorker(int listener) {
+		auto w = std::make_unique<Worker>();
+		for(;;) {
+			const int fd = accept(listener, nullptr, nullptr);
+			if(fd < 0) {
+				if(errno == EINTR || errno == ECONNABORTED)   continue;
+				return;
+			}
+			serve(*w, [fd](char* buf, size_t size) {
+				ssize_t n;
+				while((n = recv(fd, buf, size, 0)) < 0 && errno == EINTR);
+				return static_cast<long>(n);
+			}, [fd](const char* buf, size_t size) {
+				for(size_t done = 0;     done < size;     ) {
+					const ssize_t n = send(fd, buf + done, size - done, MSG_NOSIGNAL);
+					if(n < 0 && errno == EINTR)   continue;
+					if(n <= 0)   return false;
+					done += static_cast<size_t>(n);
+				}
+				return true;
+			});
+			close(fd);
+		}
+	}
+}
+
+
+bool runQueryServer(const QueryServerOptions& options, std::string& error) {
+	sockaddr_un addr{};
+	addr.sun_family = AF_UNIX;
+	if(options.endpoint.empty() || options.endpoint.size() >= sizeof(addr.sun_path)) {
+		error = "invalid socket path";
+		return false;
+	}
+	std::memcpy(addr.sun_path, options.endpoint.c_str(), options.endpoint.size() + 1);
+	const int listener = socket(AF_UNIX, SOCK_STREAM|SOCK_CLOEXEC, 0);
+	if(listener < 0) {
+		error = "the socket could not be created";
+		return false;
+	}
+	struct stat st;
+	if(lstat(options.endpoint.c_str(), &st) == 0) { // like FILE_FLAG_FIRST_PIPE_INSTANCE, a running server isn't taken over
+		if(!isStaleSocket(addr)) {
+			error = "the endpoint is already in use";
+			close(listener);
+			return false;
+		}
+		unlink(options.endpoint.c_str());
+	}
+	if(bind(listener, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) != 0 || listen(listener, SOMAXCONN) != 0) {
+		error = std::string("the socket could not be bound: ") + std::strerror(errno);
+		close(listener);
+		return false;
+	}
+	const unsigned int nThreads = (options.nThreads ? options.nThreads : std::max(1u, std::thread::hardware_concurrency()));
+	std::vector<std::thread> threads;
+	for(unsigned int i = 0;     i < nThreads;     ++i)     threads.emplace_back(socketWorker, listener);
+	for(std::thread& t : threads)     t.join();
+	close(listener);
+	return true;
+}
+
+#endif
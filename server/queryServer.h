@@ -0,0 +1,21 @@
+#pragma once
+#include "fileContent.h"
+#include <string>
+
+
+/* A resident server that answers link file queries over a local named pipe (Windows) or Unix domain socket.
+
+   The protocol is line based, everything is UTF-8 and lines end with LF (a CR before it is ignored).
+   A request is the wanted info types, separated by spaces and named like the command line flags of getLNKinfo.exe
+   (with or without '/'; none means PF), then a TAB, then the path of the link file:
+       PF W CL<TAB>C:\Users\Public\Desktop\Editor.lnk
+   The reply is "OK" followed by a TAB and the value for every info type, or "ERR", a TAB and the error message.
+   Missing infos are empty, TAB, CR, LF and backslash in values are escaped as \t, \r, \n and \\.
+   A connection may send any number of requests, the replies come in the same order. */
+struct QueryServerOptions {
+	PathString   endpoint;     // pipe name (without \\.\pipe\) or socket path
+	unsigned int nThreads = 0; // 0 = one per core; each thread serves one connection at a time
+};
+
+// Runs until the process is terminated; returns only if the endpoint can't be set up, with an error message
+bool runQueryServer(const QueryServerOptions& options, std::string& error);
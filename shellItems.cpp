@@ -0,0 +1,107 @@
+#include "lnkparse.h"
+#include "unaligned.h"
+#include "utf8.h"
+#include <cstring>
+
+/* Shell items (the ItemIDs of the LinkTargetIDList). MS-SHLLNK leaves their content to the shell, the layouts below
+   are the ones of the Windows shell's folder items as documented by libfwsi. */
+
+namespace {
+	enum ItemClass : uint8_t {
+		ROOT_FOLDER = 0x10, VOLUME = 0x20, FILE_ENTRY = 0x30, NETWORK_LOCATION = 0x40,
+		CLASS_MASK  = 0x70
+	};
+
+	// {20D04FE0-3AEA-1069-A2D8-08002B30309D} as stored; the volumes follow it, so it doesn't appear in the path
+	const unsigned char myComputer[16] = { 0xE0, 0x4F, 0xD0, 0x20, 0xEA, 0x3A, 0x69, 0x10, 0xA2, 0xD8, 0x08, 0x00, 0x2B, 0x30, 0x30, 0x9D };
+
+	constexpr uint32_t beef0004 = 0xBEEF0004;
+
+
+	// The strings are zero terminated within the item; these return the end of the terminator, nullptr if there is none
+	const char* appendANSI(std::u16string& s, const char* p, const char* end) {
+		const char* e = static_cast<const char*>(std::memchr(p, 0, static_cast<size_t>(end - p)));
+		if(!e)   return nullptr;
+		for(;     p < e;     ++p)     s += cp1252ToUnicode(static_cast<unsigned char>(*p));
+		return e + 1;
+	}
+
+	const char* appendUTF16(std::u16string& s, const char* p, const char* end) {
+		for(;     end - p >= 2;     p += 2) {
+			const char16_t c = static_cast<char16_t>(read16(p));
+			if(!c)   return p + 2;
+			s += c;
+		}
+		return nullptr;
+	}
+
+	void appendCLSID(std::u16string& s, const char* p) {
+		s += u"::";
+		for(char c : GUID_t(p).toString())     s += static_cast<char16_t>(c);
+	}
+
+
+	/* The long name of a file entry from its BEEF0004 extension block. Where the name starts in the block depends on the
+	   block version; the offset of the block is in the last two bytes of the item. */
+	bool appendLongName(std::u16string& s, const ItemID& item) {
+		const char* itemBegin = item.dataBegin - 2;
+		if(item.dataEnd - item.dataBegin < 2)   return false;
+		const char* block = itemBegin + read16(item.dataEnd - 2);
+		if(block < item.dataBegin || item.dataEnd - 2 - block < 8 || read32(block + 4) != beef0004)   return false;
+		const char* blockEnd = block + read16(block);
+		if(blockEnd > item.dataEnd)   return false;
+		const uint16_t version = read16(block + 2);
+		const int nameOffset = (version >= 9 ? 46 : version == 8 ? 42 : version == 7 ? 38 : version >= 3 ? 20 : 0);
+		if(!nameOffset || blockEnd - block <= nameOffset)   return false;
+		const size_t at = s.size();
+		if(!appendUTF16(s, block + nameOffset, blockEnd) || s.size() == at) {
+			s.resize(at);
+			return false;
+		}
+		return true;
+	}
+}
+
+
+std::u16string LinkTargetIDList::path() const {
+	std::u16string path;
+	auto separate = [&path] { if(!path.empty() && path.back() != u'\\')   path += u'\\'; };
+	for(const ItemID& item : data) {
+		const char* p = item.dataBegin;
+		const char* e = item.dataEnd;
+		const uint8_t type = item.type();
+		switch(type & CLASS_MASK) {
+		case ROOT_FOLDER: // sort index, CLSID
+			if(e - p < 18)   return std::u16string();
+			if(std::memcmp(p + 2, myComputer, 16) != 0) {
+				separate();
+				appendCLSID(path, p + 2);
+			}
+			break;
+		case VOLUME: // the drive ("C:\") if flagged so, otherwise a shell folder within My Computer
+			separate();
+			if(type & 0x01) {
+				if(!appendANSI(path, p + 1, e))   return std::u16string();
+			} else if(e - p >= 18)   appendCLSID(path, p + 2);
+			else                     return std::u16string();
+			break;
+		case FILE_ENTRY: { // file size, modification time, attributes, then the short name, in UTF-16 if flagged so
+			if(e - p < 13)   return std::u16string();
+			separate();
+			const size_t at = path.size();
+			if(!(type & 0x04 ? appendUTF16(path, p + 12, e) : appendANSI(path, p + 12, e)))   return std::u16string();
+			const size_t shortEnd = path.size();
+			if(appendLongName(path, item))   path.erase(at, shortEnd - at); // the long name replaces the short one
+			break;
+		}
+		case NETWORK_LOCATION: // the UNC path up to and including this item
+			if(e - p < 4)   return std::u16string();
+			path.clear();
+			if(!appendANSI(path, p + 3, e))   return std::u16string();
+			break;
+		default:
+			return std::u16string();
+		}
+	}
+	return path;
+}
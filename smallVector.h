@@ -0,0 +1,62 @@
+#pragma once
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+
+/* A vector that keeps up to N elements inline and only goes to the heap beyond that.
+   Just what the parser needs: appending and indexing, for trivially copyable types. */
+template<typename T, size_t N> class SmallVector {
+	static_assert(std::is_trivially_copyable<T>::value, "SmallVector moves its elements with memcpy");
+	T        local[N];
+	std::unique_ptr<T[]> heap;
+	T*       data_     = local;
+	size_t   size_     = 0;
+	size_t   capacity_ = N;
+
+	void grow() {
+		std::unique_ptr<T[]> p(new T[2 * capacity_]); // storage given with useStorage is left alone
+		std::memcpy(p.get(), data_, size_ * sizeof(T));
+		heap = std::move(p);
+		data_ = heap.get();
+		capacity_ *= 2;
+	}
+public:
+	SmallVector() = default;
+	SmallVector(const SmallVector& v) { *this = v; }
+	SmallVector& operator=(const SmallVector& v) {
+		if(this == &v)   return *this;
+		size_ = 0;
+		while(capacity_ < v.size_)     grow();
+		std::memcpy(data_, v.data_, v.size_ * sizeof(T));
+		size_ = v.size_;
+		return *this;
+	}
+
+	template<typename... Args> T& emplace_back(Args&&... args) {
+		if(size_ == capacity_)   grow();
+		return data_[size_++] = T(std::forward<Args>(args)...);
+	}
+	void push_back(const T& t) { emplace_back(t); }
+	void clear() { size_ = 0; }
+	void reserve(size_t n) { while(capacity_ < n)     grow(); }
+	// Makes the vector use memory it doesn't own (e.g. from a ParseContext) for its elements; only while it's empty
+	void useStorage(T* storage, size_t capacity) {
+		heap.reset();
+		data_ = storage;
+		capacity_ = capacity;
+	}
+
+	size_t   size()  const { return size_; }
+	bool     empty() const { return size_ == 0; }
+	T&       operator[](size_t i)       { return data_[i]; }
+	const T& operator[](size_t i) const { return data_[i]; }
+	T&       back()       { return data_[size_ - 1]; }
+	const T& back() const { return data_[size_ - 1]; }
+	T*       begin()       { return data_; }
+	const T* begin() const { return data_; }
+	T*       end()       { return data_ + size_; }
+	const T* end() const { return data_ + size_; }
+};
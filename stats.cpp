@@ -0,0 +1,155 @@
+#include "stats.h"
+#ifdef LNK_STATS
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+
+namespace {
+
+constexpr int nBuckets = 48; // bucket b counts the spans of [2^(b-1), 2^b) ns, the last one everything longer
+
+struct ThreadStats {
+	uint64_t count[stageCount]     = {};
+	uint64_t ns[stageCount]        = {};
+	uint64_t maxNs[stageCount]     = {};
+	uint64_t histogram[stageCount][nBuckets] = {};
+	uint64_t counters[counterCount]   = {};
+	uint64_t errors[errorCauseCount]  = {};
+
+	void add(const ThreadStats& t) {
+		for(int s = 0;     s < stageCount;     ++s) {
+			count[s] += t.count[s];
+			ns[s]    += t.ns[s];
+			maxNs[s] = std::max(maxNs[s], t.maxNs[s]);
+			for(int b = 0;     b < nBuckets;     ++b)     histogram[s][b] += t.histogram[s][b];
+		}
+		for(int c = 0;     c < counterCount;     ++c)        counters[c] += t.counters[c];
+		for(int e = 0;     e < errorCauseCount;     ++e)     errors[e] += t.errors[e];
+	}
+};
+
+// The counters of every thread that recorded something; they live until the end, so they can be added up after the threads are gone
+std::mutex registryMutex;
+std::vector<std::unique_ptr<ThreadStats>> registry;
+
+ThreadStats& local() {
+	thread_local ThreadStats* stats = nullptr;
+	if(!stats) {
+		std::lock_guard<std::mutex> lock(registryMutex);
+		registry.push_back(std::unique_ptr<ThreadStats>(new ThreadStats));
+		stats = registry.back().get();
+	}
+	return *stats;
+}
+
+ThreadStats total() {
+	ThreadStats t;
+	std::lock_guard<std::mutex> lock(registryMutex);
+	for(const auto& s : registry)     t.add(*s);
+	return t;
+}
+
+
+int bucket(uint64_t ns) {
+	int b = 0;
+	while(ns && b < nBuckets - 1) {
+		ns >>= 1;
+		++b;
+	}
+	return b;
+}
+
+// The upper bound of the bucket the spans up to fraction of the count fall into
+uint64_t percentile(const ThreadStats& t, int s, double fraction) {
+	const uint64_t n = static_cast<uint64_t>(t.count[s] * fraction + 0.5);
+	uint64_t seen = 0;
+	for(int b = 0;     b < nBuckets;     ++b)
+		if((seen += t.histogram[s][b]) >= n && seen)   return std::min(uint64_t(1) << b, t.maxNs[s]);
+	return t.maxNs[s];
+}
+
+
+const char* const stageNames[]   = { "open", "read", "parse", "cache", "encode", "write" };
+const char* const counterNames[] = { "files", "bytesRead", "bytesWritten" };
+const char* const causeNames[]   = { "linkBroken", "wrongHeader", "fileOpen", "fileRead", "other" };
+
+void appendf(std::string& s, const char* format, double a, double b = 0, double c = 0, double d = 0, double e = 0, double f = 0) {
+	char line[160];
+	std::snprintf(line, sizeof(line), format, a, b, c, d, e, f);
+	s += line;
+}
+
+} // namespace
+
+
+
+namespace stats {
+
+bool enabled = false;
+
+uint64_t now() {
+	return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+void record(Stage stage, uint64_t ns) {
+	ThreadStats& t = local();
+	const int s = static_cast<int>(stage);
+	++t.count[s];
+	t.ns[s] += ns;
+	t.maxNs[s] = std::max(t.maxNs[s], ns);
+	++t.histogram[s][bucket(ns)];
+}
+
+void add(Counter counter, uint64_t n) {
+	local().counters[static_cast<int>(counter)] += n;
+}
+
+void error(ErrorCause cause) {
+	++local().errors[static_cast<int>(cause)];
+}
+
+
+std::string report() {
+	const ThreadStats t = total();
+	std::string s = "stage        spans    total ms    mean us     p50 us     p99 us     max us\n";
+	for(int i = 0;     i < stageCount;     ++i) {
+		if(!t.count[i])   continue;
+		s += stageNames[i];
+		s.append(8 - std::string(stageNames[i]).size(), ' ');
+		appendf(s, "%10.0f %11.1f %10.2f %10.2f %10.2f %10.2f\n", double(t.count[i]), t.ns[i] / 1e6, t.ns[i] / 1e3 / t.count[i],
+		        percentile(t, i, 0.5) / 1e3, percentile(t, i, 0.99) / 1e3, t.maxNs[i] / 1e3);
+	}
+	appendf(s, "%.0f files, %.0f bytes read, %.0f bytes written\n", double(t.counters[0]), double(t.counters[1]), double(t.counters[2]));
+	appendf(s, "errors: %.0f broken link files, %.0f not link files, %.0f not opened, %.0f not read, %.0f other\n",
+	        double(t.errors[0]), double(t.errors[1]), double(t.errors[2]), double(t.errors[3]), double(t.errors[4]));
+	return s;
+}
+
+
+std::string reportJSON() {
+	const ThreadStats t = total();
+	std::string s = "{\"stages\":{";
+	for(int i = 0;     i < stageCount;     ++i) {
+		if(i)   s += ',';
+		(s += '"') += stageNames[i];
+		appendf(s, "\":{\"spans\":%.0f,\"ns\":%.0f,\"maxNs\":%.0f,\"histogram\":[", double(t.count[i]), double(t.ns[i]), double(t.maxNs[i]));
+		int last = nBuckets;
+		while(last > 0 && !t.histogram[i][last - 1])     --last;
+		for(int b = 0;     b < last;     ++b)     appendf(s, b ? ",%.0f" : "%.0f", double(t.histogram[i][b]));
+		s += "]}";
+	}
+	s += "},\"counters\":{";
+	for(int c = 0;     c < counterCount;     ++c)     appendf((((s += c ? ",\"" : "\"") += counterNames[c]) += "\":"), "%.0f", double(t.counters[c]));
+	s += "},\"errors\":{";
+	for(int e = 0;     e < errorCauseCount;     ++e)     appendf((((s += e ? ",\"" : "\"") += causeNames[e]) += "\":"), "%.0f", double(t.errors[e]));
+	s += "}}\n";
+	return s;
+}
+
+} // namespace stats
+
+#endif
@@ -0,0 +1,68 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+
+/* Instrumentation of the stages a link file goes through, for finding out where the time of a bulk run goes.
+   Every thread records into its own counters: the number and duration of the spans per stage with a latency
+   histogram (power of two buckets), byte and file counters and the errors by cause; they are only added up for the report.
+   It's compiled in with LNK_STATS and then records nothing until enableStats() is called, so without /STATS a span costs
+   a predictable branch. Without LNK_STATS everything here is empty and inline, and compiles to nothing. */
+
+enum struct Stage { OPEN, READ, PARSE, CACHE, ENCODE, WRITE };
+constexpr int stageCount = 6;
+
+enum struct Counter { FILES, BYTES_READ, BYTES_WRITTEN };
+constexpr int counterCount = 3;
+
+enum struct ErrorCause { LINK_BROKEN, WRONG_HEADER, FILE_OPEN, FILE_READ, OTHER };
+constexpr int errorCauseCount = 5;
+
+
+#ifdef LNK_STATS
+
+namespace stats {
+	extern bool enabled;
+	uint64_t now(); // monotonic, in ns
+	void record(Stage stage, uint64_t ns);
+	void add(Counter counter, uint64_t n);
+	void error(ErrorCause cause);
+	std::string report();     // a table for people
+	std::string reportJSON(); // everything, including the histograms
+}
+
+inline bool statsCompiledIn() { return true; }
+inline void enableStats() { stats::enabled = true; } // before any threads are started
+
+class StageSpan {
+	Stage    stage;
+	uint64_t start;
+public:
+	explicit StageSpan(Stage stage) : stage(stage), start(stats::enabled ? stats::now() : 0) { }
+	StageSpan(const StageSpan&) = delete;
+	StageSpan& operator=(const StageSpan&) = delete;
+	~StageSpan() { end(); }
+	void end() { // ends the span before the end of the scope
+		if(start)   stats::record(stage, stats::now() - start);
+		start = 0;
+	}
+};
+
+inline void countStat(Counter counter, uint64_t n = 1) { if(stats::enabled)   stats::add(counter, n); }
+inline void countError(ErrorCause cause)               { if(stats::enabled)   stats::error(cause); }
+
+#else
+
+inline bool statsCompiledIn() { return false; }
+inline void enableStats() { }
+
+class StageSpan {
+public:
+	explicit StageSpan(Stage) { }
+	void end() { }
+};
+
+inline void countStat(Counter, uint64_t = 1) { }
+inline void countError(ErrorCause) { }
+
+#endif
@@ -1,12 +1,11 @@
 #include "getLNKinfo.h"
+#include "utf8.h"
+#include "stats.h"
 #include <iostream>
 #include <utility>
 
 using std::wstring;
 
-const WError errInLNK{ L"Linkfile is broken" };
-
-
 wstring takeFilename(const wchar_t* pathFile) {
 	const wchar_t* p = pathFile;
 	wchar_t c;
@@ -25,115 +24,105 @@ wstring takePathname(const wchar_t* pathFile) { // without trailing slash
 }
 
 
-LinkTargetIDList::LinkTargetIDList(const char* begin, const char* limit) {
-	uint16_t listSize = *reinterpret_cast<const uint16_t*>(begin);
-	begin += 2;
-	if(begin + listSize > limit)   throw errInLNK;
-	afterwards = begin + listSize;
-	while(*reinterpret_cast<const uint16_t*>(begin)) {
-		data.emplace_back(begin, afterwards);
-		begin = data.back().dataEnd;
+void Output::write(const char* s, size_t n) const {
+	if(sink)   sink->append(s, n);
+	else {
+		StageSpan writing(Stage::WRITE);
+		DWORD nw = 0;
+		WriteFile(hConsole, s, static_cast<DWORD>(n), &nw, NULL);
+		countStat(Counter::BYTES_WRITTEN, nw);
 	}
-	if((begin += 2) != afterwards)   throw errInLNK;
 }
 
-
-LinkInfo::LinkInfo(const char* begin, const char* limit) {
-	const char* begin0 = begin;
-	if(begin + 4 > limit)   throw errInLNK;
-	auto& p32 = *reinterpret_cast<const uint32_t**>(&begin);
-	afterwards = begin + *p32;
-	auto nItems = (*++p32 - 12) >> 2; // 4 or 6
-	linkInfoFlags = static_cast<LinkInfoFlags>(*++p32);
-	const char* itemPointers[6]{ nullptr };
-	for(unsigned int i = 0;     i < nItems;     ++i)
-		if((itemPointers[i] = begin0 + *++p32) >= afterwards)   throw errInLNK;
-	if((int)linkInfoFlags & (int)LinkInfoFlags::VolumeIDAndLocalBasePath) {
-		if((begin = itemPointers[0]) > afterwards - 4)   throw errInLNK;
-		auto volumeIDsize = *p32;
-		if(begin + volumeIDsize > afterwards)   throw errInLNK;
-		if(((volumeID = std::make_unique<VolumeIDandBasePath>())->driveType = static_cast<int>(*++p32)) > DRIVE_RAMDISK)
-			throw errInLNK;
-		volumeID->serialNumber = *++p32;
-		if(!(volumeID->volumeLabelIsUnicode = (*++p32 == 0x14))) {
-			if((volumeID->volumeLabel = itemPointers[0] + *p32) >= afterwards)   throw errInLNK;
-		} else if((volumeID->volumeLabelUC = reinterpret_cast<const wchar_t*>(itemPointers[0] + *++p32)) >= reinterpret_cast<const wchar_t*>(afterwards))
-				throw errInLNK;
-		volumeID->localBasePath   = itemPointers[1];
-		volumeID->localBasePathUC = reinterpret_cast<const wchar_t*>(itemPointers[4]);
-	} else p32 += 2;
-	//CommonNetworkRelativeLinkOffset <=> itemPointers[2]
-	commonPathSuffix = itemPointers[3];
-	commonPathSuffixUC = reinterpret_cast<const wchar_t*>(itemPointers[5]);
+void Output::print(const wchar_t* s) const {
+	print(s, std::wcslen(s));
 }
 
+void Output::print(const char* s) const {
+	print(s, std::strlen(s));
+}
 
-
-LNK::LNK(const char* begin, const char* end) {
-	constexpr static uint32_t header[] = { 76, 0x00021401, 0, 0xC0, 0x46000000 };
-	if(end - begin < 76)   throw errInLNK;
-	auto& p16 = *reinterpret_cast<const uint16_t**>(&begin);
-	auto& p32 = *reinterpret_cast<const uint32_t**>(&begin);
-	auto& pwc = *reinterpret_cast<const wchar_t**>(&begin);
-
-	for(int i = 0;     i < 5;     ++i)
-		if(*p32++ != header[i])   throw WError(L"Wrong file header  not a proper .lnk file");
-	flags = *p32;
-	// skipping FileAttributes, CreationTime, AccessTime, WriteTime, FileSize
-	iconIdx = *(begin += 36);
-	begin += 20; // skipping ShowCommand and HotKey
-	if(flags & HasLinkTargetIDList)
-		begin = (linkTargetIDList = std::make_unique<LinkTargetIDList>(begin, end))->afterwards;
-	if(flags & HasLinkInfo)
-		begin = (linkInfo = std::make_unique<LinkInfo>(begin, end))->afterwards;
-	const size_t factor = (flags & IsUnicode ? sizeof(wchar_t) : sizeof(char));
-	for(auto& p : { std::make_pair(HasName,         &nameString),
-	                std::make_pair(HasRelativePath, &relPath),
-	                std::make_pair(HasWorkingDir,   &workingDir),
-	                std::make_pair(HasArguments,    &commandLine),
-	                std::make_pair(HasIconLocation, &iconLoc) })
-		if(flags & p.first) {
-			auto size = *p16++ * factor;
-			(*p.second = std::make_unique<std::string>(begin, begin + size))->push_back('\0');
-			begin += size;
-			// the extra '\0' above ensures the string is properly terminated even if it is a wide string
+namespace {
+	// convert(dst) writes at most maxLength bytes and returns how many it wrote. They go straight into the free space of the
+	// sink; only unbuffered console output needs a buffer of its own.
+	template<typename Convert> void encode(const Output& out, size_t maxLength, Convert convert) {
+		StageSpan encoding(Stage::ENCODE);
+		if(out.sink) {
+			const size_t at = out.sink->size();
+			out.sink->resize(at + maxLength);
+			out.sink->resize(at + convert(&(*out.sink)[at]));
+			return;
 		}
-
+		thread_local std::string buf;
+		if(buf.size() < maxLength)   buf.resize(maxLength);
+		const size_t len = convert(&buf[0]);
+		encoding.end();
+		out.write(buf.data(), len);
+	}
 }
 
+void Output::print(const wchar_t* s, size_t n) const {
+	if(n == 0)   return;
+	if(codepage == CP_UTF8) { // our own conversion is much faster for the mostly ASCII strings of link files
+		encode(*this, utf8MaxLength(n), [&](char* dst) { return utf16ToUTF8(reinterpret_cast<const char16_t*>(s), n, dst); });
+		return;
+	}
+	// no codepage needs more than 4 bytes per UTF-16 code unit
+	encode(*this, 4 * n, [&](char* dst) {
+		return static_cast<size_t>(WideCharToMultiByte(codepage, 0, s, static_cast<int>(n), dst, static_cast<int>(4 * n), NULL, NULL));
+	});
+}
 
-
-void print(const wchar_t* s, HANDLE hConsole) {
-	DWORD n = 0;
-	UINT codepage = GetConsoleOutputCP();
-	int bufferSize = WideCharToMultiByte(codepage, 0, s, -1, NULL, 0, NULL, NULL);
-	auto buf = std::unique_ptr<char[]>(new char[bufferSize]);
-	WideCharToMultiByte(codepage, 0, s, -1, buf.get(), bufferSize, NULL, NULL);
-	WriteFile(hConsole, buf.get(), bufferSize - 1, &n, NULL);
+void Output::print(const char* s, size_t n) const {
+	const char* p = s;
+	while(p != s + n && static_cast<unsigned char>(*p) < 0x80)     ++p;
+	if(p == s + n || codepage != CP_UTF8) { // ASCII is the same everywhere, and other consoles get the ANSI bytes as they are
+		write(s, n);
+		return;
+	}
+	encode(*this, utf8MaxLength(n), [&](char* dst) { return ansiToUTF8(s, n, dst); });
 }
 
-void print(const char* s, HANDLE hConsole) {
-	DWORD n = 0;
-	WriteFile(hConsole, s, static_cast<DWORD>(std::strlen(s)), &n, NULL);
+
+size_t ansiToUTF8(const char* s, size_t n, char* dst) {
+	static const bool isCP1252 = (GetACP() == 1252);
+	if(isCP1252)   return cp1252ToUTF8(s, n, dst);
+	// other ANSI codepages, including the double byte ones, have no more UTF-16 code units than bytes
+	thread_local std::wstring utf16;
+	if(utf16.size() < n)   utf16.resize(n);
+	const int len = (n ? MultiByteToWideChar(CP_ACP, 0, s, static_cast<int>(n), &utf16[0], static_cast<int>(n)) : 0);
+	return utf16ToUTF8(reinterpret_cast<const char16_t*>(utf16.data()), len, dst);
 }
 
 
 
-void outputStringItem(const LNK& lnk, StringItem item, HANDLE hConsole) {
-	std::string* s = nullptr;
+void outputStringItem(const LNK& lnk, StringItem item, const Output& out) {
+	const CopiedString* s = nullptr;
 	switch(item) {
-	case StringItem::NAMESTRING:    if(lnk.nameString)    s = lnk.nameString .get();     break;
-	case StringItem::RELPATH:       if(lnk.relPath)       s = lnk.relPath    .get();     break;
-	case StringItem::WORKINGDIR:    if(lnk.workingDir)    s = lnk.workingDir .get();     break;
-	case StringItem::COMMANDLINE:   if(lnk.commandLine)   s = lnk.commandLine.get();     break;
-	case StringItem::ICONLOC:       if(lnk.iconLoc)       s = lnk.iconLoc    .get();     break;
+	case StringItem::NAMESTRING:    if(lnk.nameString)    s = &lnk.nameString;     break;
+	case StringItem::RELPATH:       if(lnk.relPath)       s = &lnk.relPath;        break;
+	case StringItem::WORKINGDIR:    if(lnk.workingDir)    s = &lnk.workingDir;     break;
+	case StringItem::COMMANDLINE:   if(lnk.commandLine)   s = &lnk.commandLine;    break;
+	case StringItem::ICONLOC:       if(lnk.iconLoc)       s = &lnk.iconLoc;        break;
 	}
 	if(!s)   return;
-	if(lnk.flags & Flag::IsUnicode)   print(reinterpret_cast<const wchar_t*>(s->c_str()), hConsole);
-	else                              print(s->c_str(), hConsole);
+	if(lnk.flags & Flag::IsUnicode)   out.print(reinterpret_cast<const wchar_t*>(s->c_str()));
+	else                              out.print(s->c_str());
+	if(item == StringItem::ICONLOC) {
+		char buf[32];
+		sprintf_s<32>(buf, ",%u", lnk.iconIdx);
+		out.print(buf);
+	}
+}
+
+void outputStringItem(const LNKView& lnk, StringItem item, const Output& out) {
+	const StringRef& s = lnk.string(item);
+	if(!s)   return;
+	if(s.isUnicode)   out.print(wide(s.dataUC()), s.length);
+	else              out.print(s.data,     s.length);
 	if(item == StringItem::ICONLOC) {
 		char buf[32];
 		sprintf_s<32>(buf, ",%u", lnk.iconIdx);
-		print(buf, hConsole);
+		out.print(buf);
 	}
 }
@@ -0,0 +1,165 @@
+/* Lists the link files in a tar archive, see tarLinks.h.
+   Usage: lnktar [archive]   (without archive or with "-" it's read from stdin, e.g. zcat backup.tar.gz | lnktar)
+   Writes a tab separated line per link file in archive order: member name, size, LinkFlags, the target and the strings,
+   as UTF-8 with TAB, CR, LF and backslash escaped as \t, \r, \n and \\. Link files that can't be parsed go to stderr. */
+#include "tarLinks.h"
+#include "utf8.h"
+#include "unaligned.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+
+namespace {
+
+void appendUTF16(std::string& s, const char16_t* p, size_t n) {
+	const size_t at = s.size();
+	s.resize(at + utf8MaxLength(n));
+	s.resize(at + utf16ToUTF8(p, n, &s[at]));
+}
+
+void appendANSI(std::string& s, const char* p, size_t n) {
+	const size_t at = s.size();
+	s.resize(at + utf8MaxLength(n));
+	s.resize(at + cp1252ToUTF8(p, n, &s[at]));
+}
+
+// Terminated strings of the LinkInfo must end before limit
+void appendTerminated(std::string& s, const char* p, const char* limit) {
+	const char* e = p;
+	while(e < limit && *e)     ++e;
+	appendANSI(s, p, static_cast<size_t>(e - p));
+}
+
+void appendTerminated(std::string& s, const char16_t* p, const char* limit) {
+	const char16_t* e = p;
+	while(reinterpret_cast<const char*>(e + 1) <= limit && readUnit(e))     ++e;
+	appendUTF16(s, p, static_cast<size_t>(e - p));
+}
+
+
+void appendEscaped(std::string& line, const std::string& value) {
+	for(char c : value)
+		if(c != '\t' && c != '\r' && c != '\n' && c != '\\')   line += c;
+		else   (line += '\\') += (c == '\t' ? 't' : c == '\r' ? 'r' : c == '\n' ? 'n' : '\\');
+}
+
+
+/* Makes the line of a link file from its sections as they stream by; every value is converted when its section comes,
+   as the section is gone after that */
+struct LineWriter : TarLinkReader::Handler {
+	std::string name;
+	uint64_t    size = 0;
+	uint32_t    flags = 0;
+	std::string target, strings[5], machineID;
+	uint64_t    nLinks = 0, nBroken = 0;
+
+	bool member(const std::string& name, uint64_t size) override {
+		this->name = name;
+		this->size = size;
+		flags = 0;
+		target.clear();
+		for(std::string& s : strings)     s.clear();
+		machineID.clear();
+		return true;
+	}
+
+	void header(const LinkHeader& header) override { flags = header.flags; }
+
+	// the path from the shell items is only the target if there's no LinkInfo, which comes after them
+	void linkTargetIDList(const char* begin, const char* end) override {
+		if(flags & HasLinkInfo)   return;
+		const std::u16string path = LinkTargetIDList(begin, end).path();
+		appendUTF16(target, path.data(), path.size());
+	}
+
+	void linkInfo(const char* begin, const char* end) override {
+		const LinkInfo info(begin, end);
+		if(const VolumeIDandBasePath* volumeID = info.volumeID.get()) {
+			if(volumeID->localBasePathUC)   appendTerminated(target, volumeID->localBasePathUC, end);
+			else                            appendTerminated(target, volumeID->localBasePath, end);
+		}
+		if(info.commonPathSuffixUC)   appendTerminated(target, info.commonPathSuffixUC, end);
+		else                          appendTerminated(target, info.commonPathSuffix, end);
+	}
+
+	void string(StringItem item, const StringRef& s) override {
+		std::string& value = strings[static_cast<int>(item)];
+		if(s.isUnicode)   appendUTF16(value, s.dataUC(), s.length);
+		else              appendANSI(value, s.data, s.length);
+	}
+
+	void extraData(const ExtraDataBlock& block) override {
+		if(block.signature != ExtraDataSignature::TRACKER)   return;
+		const TrackerDataBlock tracker(block);
+		appendTerminated(machineID, tracker.machineID, tracker.machineID + tracker.machineIDLength);
+	}
+
+	void memberEnd(const LNK_error* error) override {
+		if(error) {
+			std::fprintf(stderr, "lnktar: %s: %s\n", name.c_str(), error->what());
+			++nBroken;
+			return;
+		}
+		std::string line;
+		appendEscaped(line, name);
+		char number[48];
+		std::snprintf(number, sizeof(number), "\t%llu\t%08X\t", static_cast<unsigned long long>(size), static_cast<unsigned int>(flags));
+		appendEscaped(line += number, target);
+		for(const std::string& s : strings)     appendEscaped(line += '\t', s);
+		appendEscaped(line += '\t', machineID);
+		std::printf("%s\n", line.c_str());
+		++nLinks;
+	}
+};
+
+
+int usage() {
+	std::fprintf(stderr, "Usage: lnktar [archive]\n");
+	return EXIT_FAILURE;
+}
+
+} // namespace
+
+
+
+int main(int argc, char* argv[]) {
+	if(argc > 2 || (argc == 2 && argv[1][0] == '-' && argv[1][1]))   return usage();
+	const bool fromStdin = (argc < 2 || std::strcmp(argv[1], "-") == 0);
+	std::FILE* file = stdin;
+#ifdef _WIN32
+	if(fromStdin)   _setmode(_fileno(stdin), _O_BINARY);
+#endif
+	if(!fromStdin && !(file = std::fopen(argv[1], "rb"))) {
+		std::fprintf(stderr, "lnktar: %s can't be opened\n", argv[1]);
+		return EXIT_FAILURE;
+	}
+
+	LineWriter writer;
+	TarLinkReader reader(writer);
+	std::vector<char> chunk(1024 * 1024);
+	const auto t0 = std::chrono::steady_clock::now();
+	std::printf("member\tsize\tflags\ttarget\tname\trelativePath\tworkingDir\targuments\ticonLocation\tmachineID\n");
+	int ret = EXIT_SUCCESS;
+	try {
+		for(size_t n;     !reader.done() && (n = std::fread(chunk.data(), 1, chunk.size(), file)) > 0;)     reader.feed(chunk.data(), n);
+		if(std::ferror(file))   throw TarError("read error");
+		reader.finish();
+	}
+	catch(const TarError& e) {
+		std::fprintf(stderr, "lnktar: %s\n", e.what());
+		ret = EXIT_FAILURE;
+	}
+	if(!fromStdin)   std::fclose(file);
+	const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+	std::fprintf(stderr, "%llu bytes in %.2f s (%.0f MB/s), %llu link files, %llu broken\n", static_cast<unsigned long long>(reader.bytes()),
+	             seconds, reader.bytes() / seconds / (1024 * 1024), static_cast<unsigned long long>(writer.nLinks), static_cast<unsigned long long>(writer.nBroken));
+	return ret;
+}
@@ -0,0 +1,208 @@
+#include "tarLinks.h"
+#include <algorithm>
+#include <cstring>
+
+
+namespace {
+
+// A text field of the header, terminated by NUL unless it fills the field
+std::string text(const char* p, size_t n) {
+	size_t length = 0;
+	while(length < n && p[length])     ++length;
+	return std::string(p, length);
+}
+
+
+// A number field of the header: octal, or base-256 for big values if the first byte has its high bit set (GNU, star)
+uint64_t number(const char* p, size_t n) {
+	uint64_t value = 0;
+	if(static_cast<unsigned char>(p[0]) & 0x80) {
+		value = static_cast<unsigned char>(p[0]) & 0x7F;
+		for(size_t i = 1;     i < n;     ++i) {
+			if(value >> 56)   throw TarError("member size out of range");
+			value = (value << 8) | static_cast<unsigned char>(p[i]);
+		}
+		return value;
+	}
+	size_t i = 0;
+	while(i < n && p[i] == ' ')     ++i;
+	for(;     i < n && p[i] >= '0' && p[i] <= '7';     ++i) {
+		if(value >> 60)   throw TarError("member size out of range");
+		value = value * 8 + static_cast<unsigned int>(p[i] - '0');
+	}
+	if(i < n && p[i] != ' ' && p[i] != '\0')   throw TarError("not a tar archive, or a damaged one");
+	return value;
+}
+
+
+// The checksum is the sum of the header bytes with the checksum field taken as spaces; some old archivers summed signed chars
+bool checksumMatches(const char* block) {
+	uint64_t sum = 0;
+	int64_t  signedSum = 0;
+	for(size_t i = 0;     i < 512;     ++i) {
+		const char c = (i >= 148 && i < 156 ? ' ' : block[i]);
+		sum       += static_cast<unsigned char>(c);
+		signedSum += static_cast<signed char>(c);
+	}
+	const uint64_t stored = number(block + 148, 8);
+	return stored == sum || static_cast<int64_t>(stored) == signedSum;
+}
+
+
+bool isLinkName(const std::string& name) {
+	if(name.size() < 4)   return false;
+	const char* e = name.data() + name.size() - 4;
+	return e[0] == '.' && (e[1] | 0x20) == 'l' && (e[2] | 0x20) == 'n' && (e[3] | 0x20) == 'k';
+}
+
+} // namespace
+
+
+
+void TarLinkReader::feed(const char* data, size_t n) {
+	const char* p = data;
+	const char* const end = data + n;
+	bytes_ += n;
+	while(p < end && state != State::END) {
+		if(state == State::HEADER) {
+			const size_t k = std::min(sizeof(block) - blockHave, static_cast<size_t>(end - p));
+			std::memcpy(block + blockHave, p, k);
+			p += k;
+			if((blockHave += k) == sizeof(block)) {
+				blockHave = 0;
+				header();
+			}
+			continue;
+		}
+		const size_t k = static_cast<size_t>(std::min<uint64_t>(remaining, static_cast<uint64_t>(end - p)));
+		if(state == State::DATA)
+			switch(sink) {
+			case Sink::LINK:
+				if(linkEnded)   break;
+				try {
+					parser.feed(p, k); // once the parser is done, it takes no more
+				}
+				catch(const LNK_error& e) {   endLink(&e);   }
+				break;
+			case Sink::LONG_NAME:
+				if(longName.size() + k > maxNameSize)   throw TarError("long name too long");
+				longName.append(p, k);
+				break;
+			case Sink::PAX:
+				if(pax.size() + k > maxRecordSize)   throw TarError("pax extended header too big");
+				pax.append(p, k);
+				break;
+			case Sink::SKIP:
+				break;
+			}
+		p += k;
+		if((remaining -= k) > 0)   continue;
+		if(state == State::DATA)   endData();
+		else                       state = State::HEADER;
+	}
+}
+
+
+void TarLinkReader::finish() {
+	if(state == State::END || (state == State::HEADER && blockHave == 0))   return; // some archivers leave out the end marker
+	throw TarError("the archive ends in the middle of a member");
+}
+
+
+// A header block is complete
+void TarLinkReader::header() {
+	if(std::all_of(block, block + sizeof(block), [](char c) { return c == '\0'; })) {
+		if(++zeroBlocks == 2)   state = State::END;
+		return;
+	}
+	zeroBlocks = 0;
+	if(!checksumMatches(block))   throw TarError("not a tar archive, or a damaged one");
+	const char type = block[156];
+	const bool isExtension = (type == 'L' || type == 'K' || type == 'x' || type == 'g'); // headers that describe the next member
+	const uint64_t size = (hasPaxSize && !isExtension ? paxSize : number(block + 124, 12));
+	sink = Sink::SKIP;
+	switch(type) {
+	case 'L':   longName.clear();   sink = Sink::LONG_NAME;   break;
+	case 'x':   pax.clear();        sink = Sink::PAX;         break;
+	case 'K':   case 'g':           break; // the long target of a hard or symbolic link, global pax records
+	default: {
+		std::string name;
+		if(!longName.empty())   name.swap(longName);
+		else {
+			name = text(block, 100);
+			const std::string prefix = (std::memcmp(block + 257, "ustar", 5) == 0 ? text(block + 345, 155) : std::string());
+			if(!prefix.empty())   name = prefix + '/' + name;
+		}
+		hasPaxSize = false;
+		if((type == '0' || type == '\0' || type == '7') && isLinkName(name) && handler.member(name, size)) {
+			parser.reset();
+			linkEnded = false;
+			sink = Sink::LINK;
+		}
+	}
+	}
+	state = State::DATA;
+	remaining = size;
+	padding = (512 - size % 512) % 512;
+	if(remaining == 0)   endData();
+}
+
+
+// The data of the current member is over
+void TarLinkReader::endData() {
+	switch(sink) {
+	case Sink::LINK:
+		if(linkEnded)   break;
+		try {
+			parser.finish();
+		}
+		catch(const LNK_error& e) {
+			endLink(&e);
+			break;
+		}
+		endLink(nullptr);
+		break;
+	case Sink::LONG_NAME:
+		longName.resize(text(longName.data(), longName.size()).size()); // it's NUL terminated
+		break;
+	case Sink::PAX:
+		parsePax();
+		break;
+	case Sink::SKIP:
+		break;
+	}
+	remaining = padding;
+	state = (remaining ? State::PADDING : State::HEADER);
+}
+
+
+void TarLinkReader::endLink(const LNK_error* error) {
+	linkEnded = true;
+	handler.memberEnd(error);
+}
+
+
+// Takes the path and size from the records of a pax extended header, "<length> <key>=<value>\n" each
+void TarLinkReader::parsePax() {
+	for(size_t at = 0;     at < pax.size();) {
+		size_t length = 0, i = at;
+		for(;     i < pax.size() && pax[i] >= '0' && pax[i] <= '9' && length < maxRecordSize;     ++i)     length = length * 10 + static_cast<size_t>(pax[i] - '0');
+		if(i == at || i >= pax.size() || pax[i] != ' ' || length <= i + 1 - at || length > pax.size() - at || pax[at + length - 1] != '\n')
+			throw TarError("damaged pax extended header");
+		const size_t keyAt = i + 1, recordEnd = at + length - 1;
+		const size_t equals = pax.find('=', keyAt);
+		if(equals >= recordEnd)   throw TarError("damaged pax extended header");
+		const std::string key = pax.substr(keyAt, equals - keyAt);
+		if(key == "path")   longName = pax.substr(equals + 1, recordEnd - equals - 1);
+		else if(key == "size") {
+			paxSize = 0;
+			for(size_t d = equals + 1;     d < recordEnd;     ++d) {
+				if(pax[d] < '0' || pax[d] > '9' || paxSize > (UINT64_MAX - 9) / 10)   throw TarError("damaged pax extended header");
+				paxSize = paxSize * 10 + static_cast<unsigned int>(pax[d] - '0');
+			}
+			hasPaxSize = true;
+		}
+		at += length;
+	}
+	pax.clear();
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include "lnkStream.h"
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+
+
+/* Reads the link files out of a tar archive (ustar, with GNU long names and pax path and size records) that arrives in chunks,
+   e.g. from a pipe, in a single sequential pass. Every regular member whose name ends in .lnk goes through a LinkStreamParser
+   while it passes by; the other members are skipped. Nothing but the current tar header block, a long name and the parser's
+   current section is held in memory, however big the archive is. Compressed archives can be piped through a decompressor. */
+
+struct TarError : std::runtime_error {
+	explicit TarError(const char* message) : std::runtime_error(message) { }
+};
+
+
+class TarLinkReader {
+public:
+	struct Handler : LinkStreamParser::Handler {
+		// A link file member starts, and its sections will be reported to this handler; false to skip it
+		virtual bool member(const std::string& /*name*/, uint64_t /*size*/) { return true; }
+		// The member is over; error is why it couldn't be parsed, nullptr if it could
+		virtual void memberEnd(const LNK_error* /*error*/) { }
+	};
+
+	static constexpr size_t maxNameSize   = 64 * 1024;   // of GNU long names
+	static constexpr size_t maxRecordSize = 1024 * 1024; // of pax extended headers
+
+	explicit TarLinkReader(Handler& handler, uint32_t parts = ALL_PARTS) : handler(handler), parser(handler, parts) { }
+	// Throws TarError if it isn't a tar archive or it's damaged
+	void feed(const char* data, size_t n);
+	// The archive has ended; throws TarError if it was in the middle of a member
+	void finish();
+	bool     done()  const { return state == State::END; } // the end of archive marker has been read
+	uint64_t bytes() const { return bytes_; }
+
+private:
+	enum struct State { HEADER, DATA, PADDING, END };
+	enum struct Sink { SKIP, LINK, LONG_NAME, PAX }; // where the data of the current member goes
+
+	Handler& handler;
+	LinkStreamParser parser;
+	State    state = State::HEADER;
+	char     block[512];
+	size_t   blockHave = 0;
+	int      zeroBlocks = 0;  // in a row; two end the archive
+	Sink     sink = Sink::SKIP;
+	uint64_t remaining = 0;   // of the member data, or of the padding after it
+	uint64_t padding = 0;     // after the member data, up to the next block
+	bool     linkEnded = false;
+	std::string longName;     // for the next member, from a GNU long name or pax path record
+	std::string pax;          // the pax extended header being read
+	uint64_t paxSize = 0;     // for the next member, if a pax record had one
+	bool     hasPaxSize = false;
+	uint64_t bytes_ = 0;
+
+	void header();
+	void endData();
+	void endLink(const LNK_error* error);
+	void parsePax();
+};
@@ -0,0 +1,130 @@
+#include "targetCheck.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <unordered_map>
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <cerrno>
+#include <sys/stat.h>
+#endif
+
+
+namespace {
+
+#ifdef _WIN32
+bool isSeparator(PathChar c) { return c == L'\\' || c == L'/'; }
+#else
+bool isSeparator(PathChar c) { return c == '/'; }
+#endif
+
+
+// The key a path is deduplicated by: without trailing separators, and on Windows with backslashes only and case folded like NTFS does
+PathString normalized(const PathString& path) {
+	PathString s = path;
+#ifdef _WIN32
+	std::replace(s.begin(), s.end(), L'/', L'\\');
+	if(!s.empty())   CharLowerBuff(&s[0], static_cast<DWORD>(s.size()));
+	while(s.size() > 1 && isSeparator(s.back()) && !(s.size() == 3 && s[1] == L':'))   s.pop_back(); // but "C:\" stays
+#else
+	while(s.size() > 1 && isSeparator(s.back()))   s.pop_back();
+#endif
+	return s;
+}
+
+
+// The directory a normalized path is in; empty if it's a root or has no directory
+PathString parentOf(const PathString& path) {
+	size_t i = path.size();
+	while(i > 0 && !isSeparator(path[i - 1]))     --i;
+	if(i == 0 || i == path.size())   return PathString();
+	PathString parent = path.substr(0, i - 1);
+	if(parent.empty() || (parent.size() == 2 && parent[1] == ':'))   parent += path[i - 1]; // "/" or "C:\"
+	return parent;
+}
+
+
+TargetState query(const PathString& path) {
+#ifdef _WIN32
+	WIN32_FILE_ATTRIBUTE_DATA data;
+	if(GetFileAttributesEx(path.c_str(), GetFileExInfoStandard, &data))   return TargetState::EXISTS;
+	switch(GetLastError()) {
+	case ERROR_FILE_NOT_FOUND:
+	case ERROR_PATH_NOT_FOUND:
+	case ERROR_INVALID_DRIVE:
+	case ERROR_BAD_NET_NAME:    return TargetState::MISSING; // a share the server doesn't have (anymore)
+	default:                    return TargetState::UNKNOWN;
+	}
+#else
+	struct stat st;
+	if(stat(path.c_str(), &st) == 0)   return TargetState::EXISTS;
+	return (errno == ENOENT || errno == ENOTDIR ? TargetState::MISSING : TargetState::UNKNOWN);
+#endif
+}
+
+
+// Looks up all paths, nThreads at a time
+std::vector<TargetState> queryAll(const std::vector<const PathString*>& paths, unsigned int nThreads) {
+	std::vector<TargetState> states(paths.size(), TargetState::UNKNOWN);
+	std::atomic<size_t> next{ 0 };
+	auto work = [&] {
+		for(size_t i;     (i = next++) < paths.size();)     states[i] = query(*paths[i]);
+	};
+	nThreads = static_cast<unsigned int>(std::min<size_t>(nThreads, paths.size()));
+	std::vector<std::thread> threads;
+	for(unsigned int t = 1;     t < nThreads;     ++t)     threads.emplace_back(work);
+	work();
+	for(std::thread& t : threads)     t.join();
+	return states;
+}
+
+} // namespace
+
+
+
+std::vector<TargetState> checkTargets(const std::vector<PathString>& paths, unsigned int nThreads) {
+	if(nThreads == 0)   nThreads = std::max(16u, 4 * std::thread::hardware_concurrency());
+
+	// the unique targets, and for every path which one it is
+	std::unordered_map<PathString, size_t> targetIndex;
+	std::vector<const PathString*> targets;
+	std::vector<size_t> which(paths.size());
+	for(size_t i = 0;     i < paths.size();     ++i) {
+		const auto r = targetIndex.emplace(normalized(paths[i]), targets.size());
+		if(r.second)   targets.push_back(&r.first->first);
+		which[i] = r.first->second;
+	}
+
+	// the directories that more than one target is in are looked up first; for the others that would only be a lookup more
+	std::vector<PathString> parents(targets.size());
+	std::unordered_map<PathString, size_t> folderIndex; // first the number of targets in the folder, then its index in folders
+	for(size_t t = 0;     t < targets.size();     ++t)
+		if(!(parents[t] = parentOf(*targets[t])).empty())   ++folderIndex[parents[t]];
+	std::vector<const PathString*> folders;
+	for(auto& f : folderIndex)
+		if(f.second > 1) {
+			f.second = folders.size();
+			folders.push_back(&f.first);
+		} else f.second = SIZE_MAX;
+	std::vector<size_t> folderOf(targets.size(), SIZE_MAX);
+	for(size_t t = 0;     t < targets.size();     ++t)
+		if(!parents[t].empty())   folderOf[t] = folderIndex[parents[t]];
+	const std::vector<TargetState> folderStates = queryAll(folders, nThreads);
+
+	std::vector<TargetState> targetStates(targets.size(), TargetState::FOLDER_MISSING);
+	std::vector<const PathString*> remaining;
+	std::vector<size_t> remainingIndex;
+	for(size_t t = 0;     t < targets.size();     ++t) {
+		if(folderOf[t] != SIZE_MAX && folderStates[folderOf[t]] == TargetState::MISSING)   continue;
+		remaining.push_back(targets[t]);
+		remainingIndex.push_back(t);
+	}
+	const std::vector<TargetState> remainingStates = queryAll(remaining, nThreads);
+	for(size_t i = 0;     i < remaining.size();     ++i)     targetStates[remainingIndex[i]] = remainingStates[i];
+
+	std::vector<TargetState> states(paths.size());
+	for(size_t i = 0;     i < paths.size();     ++i)     states[i] = targetStates[which[i]];
+	return states;
+}
@@ -0,0 +1,22 @@
+#pragma once
+#include "fileContent.h"
+#include <cstdint>
+#include <vector>
+
+
+/* Existence checks for the targets of many link files at once, for finding the broken links.
+   The paths are deduplicated first (on Windows case insensitively), so a target that many links point to is looked up only once,
+   and a directory that several targets are in is looked up before them: if it's gone, so are they, without a lookup each.
+   The lookups only query metadata, nothing is opened, and they run on a pool of threads, since a single one can take long
+   on a network share or a disk that has to spin up. */
+
+enum struct TargetState : uint8_t {
+	EXISTS,
+	MISSING,
+	FOLDER_MISSING, // the directory the target is in is missing too
+	UNKNOWN         // couldn't be found out, e.g. access denied or the server unreachable
+};
+
+
+// The state of every path, in the same order. nThreads is the number of lookups running at a time, 0 = 4 per core (at least 16)
+std::vector<TargetState> checkTargets(const std::vector<PathString>& paths, unsigned int nThreads = 0);
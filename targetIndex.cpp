@@ -0,0 +1,170 @@
+#include "targetIndex.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+
+namespace {
+	constexpr char     indexMagic[8] = { 'L', 'N', 'K', 'I', 'N', 'D', 'E', 'X' };
+	constexpr uint32_t indexVersion  = 1;
+	constexpr size_t   maxKeyLength  = 0xFFFF;
+
+	struct Header {
+		char     magic[8];
+		uint32_t version;
+		uint32_t pathCharSize; // index files of Windows and of other systems are not interchangeable
+		uint32_t nEntries;
+		uint32_t nBlocks;
+		uint32_t nLinks;
+		uint32_t blockSize;
+		uint64_t blocksEnd;    // the blocks start right after the header
+		uint64_t blockIndex;   // offset of the offsets of the blocks (uint64_t)
+		uint64_t linkTable;    // offset of the LinkRecords
+		uint64_t reserved[2];
+	};
+
+	// followed by the rest of the key, padded to a multiple of 4 bytes
+	struct KeyRecord {
+		uint16_t shared;       // the length of the prefix it has in common with the key before, 0 for the first of a block
+		uint16_t suffixLength;
+		uint32_t volumeSerial;
+		uint32_t link;
+		const char16_t* suffix() const { return reinterpret_cast<const char16_t*>(this + 1); }
+		size_t size() const { return sizeof(KeyRecord) + ((suffixLength * sizeof(char16_t) + 3) & ~size_t{ 3 }); }
+	};
+
+	// the target (char16_t) and then the path of the link file (PathChar) are at offset
+	struct LinkRecord {
+		uint64_t offset;
+		uint32_t pathLength;
+		uint32_t targetLength;
+	};
+
+	char16_t fold(char16_t c) { return (c >= u'a' && c <= u'z' ? static_cast<char16_t>(c - (u'a' - u'A')) : c == u'/' ? u'\\' : c); }
+
+	std::u16string folded(const std::u16string& s) {
+		std::u16string f(s);
+		for(char16_t& c : f)     c = fold(c);
+		return f;
+	}
+
+	template<typename T> void append(std::string& image, const T* p, size_t n) { image.append(reinterpret_cast<const char*>(p), n * sizeof(T)); }
+	void pad(std::string& image, size_t alignment) { image.resize((image.size() + alignment - 1) & ~(alignment - 1), '\0'); }
+}
+
+
+void TargetIndexWriter::add(const PathString& link, const std::u16string& target, uint32_t volumeSerial) {
+	if(target.size() > maxKeyLength)   return; // not a path Windows could open anyway
+	entries.push_back(Entry{ folded(target), volumeSerial, static_cast<uint32_t>(links.size()) });
+	links.push_back(link);
+	targets.push_back(target);
+}
+
+
+bool TargetIndexWriter::write(const PathChar* indexFile) {
+	std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) { return a.key < b.key || (a.key == b.key && a.link < b.link); });
+	std::string image(sizeof(Header), '\0');
+	std::vector<uint64_t> blockOffsets;
+	for(size_t i = 0;     i < entries.size();     ++i) {
+		const Entry& e = entries[i];
+		size_t shared = 0;
+		if(i % blockSize == 0)   blockOffsets.push_back(image.size());
+		else {
+			const std::u16string& previous = entries[i - 1].key;
+			while(shared < previous.size() && shared < e.key.size() && previous[shared] == e.key[shared])     ++shared;
+		}
+		const KeyRecord r{ static_cast<uint16_t>(shared), static_cast<uint16_t>(e.key.size() - shared), e.volumeSerial, e.link };
+		append(image, &r, 1);
+		append(image, e.key.data() + shared, e.key.size() - shared);
+		pad(image, 4);
+	}
+	Header h;
+	std::memset(&h, 0, sizeof(h));
+	std::memcpy(h.magic, indexMagic, sizeof(indexMagic));
+	h.version      = indexVersion;
+	h.pathCharSize = sizeof(PathChar);
+	h.nEntries     = static_cast<uint32_t>(entries.size());
+	h.nBlocks      = static_cast<uint32_t>(blockOffsets.size());
+	h.nLinks       = static_cast<uint32_t>(links.size());
+	h.blockSize    = blockSize;
+	h.blocksEnd    = image.size();
+	pad(image, 8);
+	h.blockIndex   = image.size();
+	append(image, blockOffsets.data(), blockOffsets.size());
+	std::vector<LinkRecord> linkRecords(links.size());
+	for(size_t i = 0;     i < links.size();     ++i) {
+		pad(image, 8);
+		linkRecords[i] = LinkRecord{ image.size(), static_cast<uint32_t>(links[i].size()), static_cast<uint32_t>(targets[i].size()) };
+		append(image, targets[i].data(), targets[i].size());
+		append(image, links[i].data(), links[i].size());
+	}
+	pad(image, 8);
+	h.linkTable    = image.size();
+	append(image, linkRecords.data(), linkRecords.size());
+	std::memcpy(&image[0], &h, sizeof(h));
+
+	std::ofstream file(indexFile, std::ios_base::binary|std::ios_base::trunc);
+	return static_cast<bool>(file.write(image.data(), static_cast<std::streamsize>(image.size())));
+}
+
+
+
+bool TargetIndex::open(const PathChar* indexFile) {
+	content.load(indexFile);
+	nBlocks = nLinks = 0;
+	const uint64_t size = content.size();
+	if(size < sizeof(Header))   return false;
+	const Header& h = *reinterpret_cast<const Header*>(content.begin());
+	if(std::memcmp(h.magic, indexMagic, sizeof(indexMagic)) != 0 || h.version != indexVersion || h.pathCharSize != sizeof(PathChar) ||
+	   h.blocksEnd < sizeof(Header) || h.blocksEnd > size || h.blockIndex > size || (size - h.blockIndex) / sizeof(uint64_t) < h.nBlocks ||
+	   h.linkTable > size || (size - h.linkTable) / sizeof(LinkRecord) < h.nLinks || h.blockIndex % 8 || h.linkTable % 8)   return false;
+	blocks       = content.begin() + sizeof(Header);
+	blocksEnd    = content.begin() + h.blocksEnd;
+	blockOffsets = reinterpret_cast<const uint64_t*>(content.begin() + h.blockIndex);
+	links        = content.begin() + h.linkTable;
+	for(uint32_t b = 0;     b < h.nBlocks;     ++b)
+		if(blockOffsets[b] < sizeof(Header) || blockOffsets[b] + sizeof(KeyRecord) > h.blocksEnd || blockOffsets[b] % 4)   return false;
+	nBlocks = h.nBlocks;
+	nLinks  = h.nLinks;
+	return true;
+}
+
+
+size_t TargetIndex::query(const std::u16string& prefix, const std::function<void(const IndexedLink&)>& found, const uint32_t* volumeSerial) const {
+	if(nBlocks == 0)   return 0;
+	const std::u16string p = folded(prefix);
+	// the keys that start with the prefix can begin in the last block whose first key is less than it, but not before
+	auto firstKeyLess = [&](uint32_t b) {
+		const KeyRecord& r = *reinterpret_cast<const KeyRecord*>(content.begin() + blockOffsets[b]);
+		const size_t n = std::min<size_t>(r.suffixLength, static_cast<size_t>(blocksEnd - reinterpret_cast<const char*>(r.suffix())) / sizeof(char16_t));
+		const int c = std::char_traits<char16_t>::compare(r.suffix(), p.data(), std::min(n, p.size()));
+		return c < 0 || (c == 0 && n < p.size());
+	};
+	uint32_t lo = 0, hi = nBlocks;
+	while(lo < hi) {
+		const uint32_t mid = lo + (hi - lo) / 2;
+		if(firstKeyLess(mid))   lo = mid + 1;
+		else                    hi = mid;
+	}
+	const char* end = content.end();
+	std::u16string key;
+	size_t n = 0;
+	for(const char* at = content.begin() + blockOffsets[lo ? lo - 1 : 0];     at + sizeof(KeyRecord) <= blocksEnd;) {
+		const KeyRecord& r = *reinterpret_cast<const KeyRecord*>(at);
+		if(r.size() > static_cast<size_t>(blocksEnd - at))   break; // a damaged index
+		key.resize(std::min<size_t>(r.shared, key.size()));
+		key.append(r.suffix(), r.suffixLength);
+		at += r.size();
+		const int c = key.compare(0, p.size(), p);
+		if(c < 0)   continue;
+		if(c > 0)   break;
+		if((volumeSerial && r.volumeSerial != *volumeSerial) || r.link >= nLinks)   continue;
+		const LinkRecord& l = reinterpret_cast<const LinkRecord*>(links)[r.link];
+		if(l.offset > static_cast<uint64_t>(end - content.begin()) ||
+		   l.targetLength * sizeof(char16_t) + l.pathLength * sizeof(PathChar) > static_cast<uint64_t>(end - content.begin() - l.offset))   continue;
+		const char16_t* target = reinterpret_cast<const char16_t*>(content.begin() + l.offset);
+		found(IndexedLink{ reinterpret_cast<const PathChar*>(target + l.targetLength), l.pathLength, target, l.targetLength, r.volumeSerial });
+		++n;
+	}
+	return n;
+}
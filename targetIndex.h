@@ -0,0 +1,56 @@
+#pragma once
+#include "fileContent.h"
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+
+/* An inverted index of link files by their target, for questions like "which links point into \\fileserver\dept\?".
+   The targets are sorted and stored in blocks of blockSize keys: the first key of a block whole, the others as the length of the
+   prefix they share with the key before and the rest. A prefix query is a binary search over the first keys of the blocks and
+   a scan from there, on the mapped file; nothing but the blocks the matches are in is touched.
+   Keys compare like Windows paths do: ASCII letters case insensitively and / the same as \. */
+
+struct IndexedLink {
+	const PathChar* link;   // the link file
+	size_t          linkLength;
+	const char16_t* target; // as the link file has it
+	size_t          targetLength;
+	uint32_t        volumeSerial; // of the volume the target is on, 0 if unknown
+};
+
+
+class TargetIndexWriter {
+	struct Entry {
+		std::u16string key;
+		uint32_t       volumeSerial;
+		uint32_t       link;
+	};
+	std::vector<Entry>      entries;
+	std::vector<PathString> links;
+	std::vector<std::u16string> targets;
+public:
+	static constexpr uint32_t blockSize = 16;
+
+	void add(const PathString& link, const std::u16string& target, uint32_t volumeSerial);
+	size_t size() const { return entries.size(); }
+	bool write(const PathChar* indexFile); // false if the file couldn't be written
+};
+
+
+class TargetIndex {
+	FileContent content;
+	const char* blocks      = nullptr;
+	const char* blocksEnd   = nullptr;
+	const uint64_t* blockOffsets = nullptr;
+	uint32_t    nBlocks     = 0;
+	const char* links       = nullptr;
+	uint32_t    nLinks      = 0;
+public:
+	// throws FileError if the file can't be read, returns false if it isn't an index
+	bool open(const PathChar* indexFile);
+	/* Calls found for every link whose target starts with prefix, ordered by target; returns how many there were.
+	   With volumeSerial only those on that volume. */
+	size_t query(const std::u16string& prefix, const std::function<void(const IndexedLink&)>& found, const uint32_t* volumeSerial = nullptr) const;
+};
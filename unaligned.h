@@ -0,0 +1,13 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+
+
+/* Little endian fields of link files. The content is a char buffer and the fields aren't necessarily aligned (ItemIDs and
+   ExtraData blocks can start at any offset), so they are copied out, which compilers turn into a plain load. */
+inline uint16_t read16(const char* p) { uint16_t v;     std::memcpy(&v, p, sizeof(v));     return v; }
+inline uint32_t read32(const char* p) { uint32_t v;     std::memcpy(&v, p, sizeof(v));     return v; }
+
+// A code unit of a string in the content; UTF-16 strings are as unaligned as the fields
+inline char     readUnit(const char* p)     { return *p; }
+inline char16_t readUnit(const char16_t* p) { char16_t c;     std::memcpy(&c, p, sizeof(c));     return c; }
@@ -0,0 +1,106 @@
+#include "utf8.h"
+#include "cpuFeatures.h"
+#include "unaligned.h"
+#include <cstdint>
+
+
+namespace {
+
+#ifdef LNK_SSE2
+
+// Each of these converts the leading ASCII code units of p, as many as it can in whole blocks, and returns their number
+size_t asciiSSE2(const char16_t* p, size_t n, char* d) {
+	const __m128i nonASCII = _mm_set1_epi16(static_cast<short>(0xFF80));
+	size_t i = 0;
+	for(;     i + 8 <= n;     i += 8) {
+		const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+		if(_mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(v, nonASCII), _mm_setzero_si128())) != 0xFFFF)   break;
+		_mm_storel_epi64(reinterpret_cast<__m128i*>(d + i), _mm_packus_epi16(v, v));
+	}
+	return i;
+}
+
+
+LNK_TARGET_AVX2 size_t asciiAVX2(const char16_t* p, size_t n, char* d) {
+	const __m256i nonASCII = _mm256_set1_epi16(static_cast<short>(0xFF80));
+	size_t i = 0;
+	for(;     i + 16 <= n;     i += 16) {
+		const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i));
+		if(!_mm256_testz_si256(v, nonASCII))   break;
+		// packus works within the 128 bit lanes, so the two halves have to be brought together afterwards
+		const __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(v, v), 0xD8);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(d + i), _mm256_castsi256_si128(packed));
+	}
+	return i + asciiSSE2(p + i, n - i, d + i);
+}
+
+
+using AsciiRun = size_t (*)(const char16_t* p, size_t n, char* d);
+const AsciiRun asciiRun = (hasAVX2() ? asciiAVX2 : asciiSSE2); // decided once per program run
+
+#else
+
+size_t asciiRun(const char16_t* p, size_t n, char* d) {
+	size_t i = 0;
+	for(;     i < n && readUnit(p + i) < 0x80;     ++i)     d[i] = static_cast<char>(readUnit(p + i));
+	return i;
+}
+
+#endif
+
+} // namespace
+
+
+size_t utf16ToUTF8(const char16_t* src, size_t n, char* dst) {
+	const char16_t* p = src;
+	const char16_t* const e = src + n;
+	char* d = dst;
+	while(p < e) {
+		const size_t k = asciiRun(p, static_cast<size_t>(e - p), d);
+		p += k;
+		d += k;
+		while(p < e && readUnit(p) < 0x80)     *d++ = static_cast<char>(readUnit(p++)); // the rest of the block that ended the ASCII run
+		// then the non-ASCII characters one at a time, until the next ASCII character
+		while(p < e && readUnit(p) >= 0x80) {
+			uint32_t c = readUnit(p++);
+			if(c < 0x800) {
+				*d++ = static_cast<char>(0xC0 | (c >> 6));
+				*d++ = static_cast<char>(0x80 | (c & 0x3F));
+				continue;
+			}
+			if(c >= 0xD800 && c < 0xE000) {
+				if(c < 0xDC00 && p < e && readUnit(p) >= 0xDC00 && readUnit(p) < 0xE000) {
+					c = 0x10000 + ((c - 0xD800) << 10) + (readUnit(p++) - 0xDC00);
+					*d++ = static_cast<char>(0xF0 | (c >> 18));
+					*d++ = static_cast<char>(0x80 | ((c >> 12) & 0x3F));
+					*d++ = static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+					*d++ = static_cast<char>(0x80 | (c & 0x3F));
+					continue;
+				}
+				c = 0xFFFD; // unpaired surrogate
+			}
+			*d++ = static_cast<char>(0xE0 | (c >> 12));
+			*d++ = static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+			*d++ = static_cast<char>(0x80 | (c & 0x3F));
+		}
+	}
+	return static_cast<size_t>(d - dst);
+}
+
+
+const char16_t cp1252High[32] = {
+	0x20AC, 0xFFFD, 0x201A, 0x0192, 0x201E, 0x2026, 0x2020, 0x2021, 0x02C6, 0x2030, 0x0160, 0x2039, 0x0152, 0xFFFD, 0x017D, 0xFFFD,
+	0xFFFD, 0x2018, 0x2019, 0x201C, 0x201D, 0x2022, 0x2013, 0x2014, 0x02DC, 0x2122, 0x0161, 0x203A, 0x0153, 0xFFFD, 0x017E, 0x0178 };
+
+
+size_t cp1252ToUTF8(const char* src, size_t n, char* dst) {
+	char* d = dst;
+	for(size_t i = 0;     i < n;     ++i) {
+		const char16_t c = cp1252ToUnicode(static_cast<unsigned char>(src[i]));
+		if(c < 0x80)         *d++ = static_cast<char>(c);
+		else if(c < 0x800) { *d++ = static_cast<char>(0xC0 | (c >> 6));     *d++ = static_cast<char>(0x80 | (c & 0x3F)); }
+		else               { *d++ = static_cast<char>(0xE0 | (c >> 12));    *d++ = static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+		                     *d++ = static_cast<char>(0x80 | (c & 0x3F)); }
+	}
+	return static_cast<size_t>(d - dst);
+}
@@ -0,0 +1,21 @@
+#pragma once
+#include <cstddef>
+
+
+/* UTF-16 to UTF-8 conversion in a single pass straight into the destination buffer.
+   Link file strings are mostly ASCII, so ASCII runs are converted 16 (AVX2) or 8 (SSE2) code units at a time
+   where the CPU supports it; the remaining characters go through a scalar loop. */
+
+// A UTF-16 code unit never takes more than 3 bytes in UTF-8 (a surrogate pair takes 4 for 2 units)
+constexpr size_t utf8MaxLength(size_t n) { return 3 * n; }
+
+// dst must have room for utf8MaxLength(n) bytes; unpaired surrogates become U+FFFD. Returns the number of bytes written.
+size_t utf16ToUTF8(const char16_t* src, size_t n, char* dst);
+
+
+/* ANSI strings are taken to be Windows-1252, which is what link files created on western systems contain */
+extern const char16_t cp1252High[32]; // the characters 0x80 to 0x9F; the rest of the codepage coincides with Unicode
+inline char16_t cp1252ToUnicode(unsigned char c) { return (c >= 0x80 && c < 0xA0 ? cp1252High[c - 0x80] : c); }
+
+// dst must have room for utf8MaxLength(n) bytes. Returns the number of bytes written.
+size_t cp1252ToUTF8(const char* src, size_t n, char* dst);